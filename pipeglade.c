@@ -30,36 +30,60 @@
 #include <gtk/gtkunixprint.h>
 #include <gtk/gtkx.h>
 #include <inttypes.h>
-#include <libxml/xpath.h>
+#include <libxml/parser.h>
+#include <limits.h>
 #include <locale.h>
 #include <math.h>
+#include <poll.h>
 #include <pthread.h>
+#include <signal.h>
 #include <stdio.h>
 #include <stdarg.h>
 #include <stdbool.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
 #include <sys/select.h>
+#include <sys/socket.h>
 #include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
 #include <time.h>
 #include <unistd.h>
 
 #define VERSION "4.8.0"
 #define BUFLEN 256
+#define RDBUFLEN 65536
+#define QUEUE_LEN 1024
+#define MAX_TXN_LEN (16 * QUEUE_LEN)
+#define DRAIN_BUDGET 10000
+#define FRAME_WAIT 100
+#define MAX_CLIENTS 64
+#define MAX_FRAME_LEN (64 << 20)
+#define MAX_SERIES_LEN (1 << 20)
+#define MIN_TILE_SIZE 64
 #define WHITESPACE " \t\n"
 #define MAIN_WIN "main"
 #define USAGE                                           \
         "usage: pipeglade [[-i in-fifo] "               \
                           "[-o out-fifo] "              \
                           "[-b] "                       \
+                          "[-B] "                       \
+                          "[-C] "                       \
+                          "[-F] "                       \
                           "[-u glade-file.ui] "         \
-                          "[-e xid]\n"                  \
-        "                  [-l log-file] "              \
+                          "[-c css-file]\n"             \
+        "                  [-s socket] "                \
+                          "[-e xid] "                   \
+                          "[-l log-file] "              \
+                          "[-T] "                       \
                           "[-O err-file] "              \
                           "[--display X-server]] | "    \
                          "[-h |"                        \
                           "-G |"                        \
-                          "-V]\n"
+                          "-V]\n"                        \
+        "       pipeglade -Z socket [glade-file.ui ...]\n" \
+        "       pipeglade -z socket [option ...]\n"
 
 #define ABORT                                           \
         do {                                            \
@@ -121,9 +145,9 @@ show_lib_versions(void)
 
 /*
  * XEmbed us if xid_s is given, or show a standalone window; give up
- * on errors
+ * on errors.  Return the toplevel widget shown.
  */
-static void
+static GtkWidget *
 xembed_if(char *xid_s, GObject *main_window)
 {
         GtkWidget *plug, *body;
@@ -132,7 +156,7 @@ xembed_if(char *xid_s, GObject *main_window)
 
         if (xid_s == NULL) {    /* standalone */
                 gtk_widget_show(GTK_WIDGET(main_window));
-                return;
+                return GTK_WIDGET(main_window);
         }
         /* We're being XEmbedded */
         xid = strtoul(xid_s, NULL, 10);
@@ -148,6 +172,7 @@ xembed_if(char *xid_s, GObject *main_window)
                     "unable to embed into XEmbed socket %s\n", xid_s);
         gtk_container_add(GTK_CONTAINER(plug), body);
         gtk_widget_show(plug);
+        return plug;
 }
 
 /*
@@ -222,6 +247,12 @@ lc_numeric_free(char *lc)
         free(lc);
 }
 
+/*
+ * Number of warnings about malformed commands so far; used inside
+ * gtk_main() only
+ */
+static unsigned long long int ignored = 0;
+
 /*
  * Print a warning about a malformed command to stderr.  Runs inside
  * gtk_main().
@@ -231,6 +262,7 @@ ign_cmd(GType type, const char *msg)
 {
         const char *name, *pad = " ";
 
+        ignored++;
         if (type == G_TYPE_INVALID) {
                 name = "";
                 pad = "";
@@ -290,6 +322,32 @@ open_fifo(const char *name, const char *fmode, FILE *fallback, int bmode)
         return s;
 }
 
+/*
+ * Create a Unix domain socket name with permissions 0600, and listen
+ * on it.  Give up if name exists.
+ */
+static int
+open_socket(const char *name)
+{
+        struct sockaddr_un sa = {.sun_family = AF_UNIX};
+        mode_t mask;
+        int fd, r;
+
+        if (strlen(name) >= sizeof(sa.sun_path))
+                bye(EXIT_FAILURE, stderr, "socket name %s too long\n", name);
+        strcpy(sa.sun_path, name);
+        if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0)
+                bye(EXIT_FAILURE, stderr, "making socket %s: %s\n",
+                    name, strerror(errno));
+        mask = umask(0077);
+        r = bind(fd, (struct sockaddr *) &sa, sizeof(sa));
+        umask(mask);
+        if (r < 0 || listen(fd, SOMAXCONN) < 0)
+                bye(EXIT_FAILURE, stderr, "opening socket %s: %s\n",
+                    name, strerror(errno));
+        return fd;
+}
+
 /*
  * Create a log file if necessary, and open it.  A name of "-"
  * requests use of stderr.
@@ -385,6 +443,127 @@ log_msg(FILE *l, char *msg)
         clock_gettime(CLOCK_MONOTONIC, &start);
 }
 
+/*
+ * Startup timing (-T): microseconds since main() began at the end of
+ * each startup phase, and the cost of preparing each type of widget
+ */
+#define MAX_PHASES 8
+
+struct type_cost {
+        unsigned int count;
+        long long int nsec;
+};
+
+static struct {
+        struct timespec start;
+        FILE *report;           /* NULL unless -T */
+        int n, reported;
+        const char *phase[MAX_PHASES];
+        long int usec[MAX_PHASES];
+        GHashTable *types;      /* GType -> struct type_cost */
+} startup;
+
+static void
+startup_mark(const char *phase)
+{
+        if (startup.n == MAX_PHASES)
+                ABORT;
+        startup.phase[startup.n] = phase;
+        startup.usec[startup.n++] = usec_since(&startup.start);
+}
+
+static gint
+cmp_type_names(gconstpointer a, gconstpointer b)
+{
+        return strcmp(g_type_name(GPOINTER_TO_SIZE(a)),
+                      g_type_name(GPOINTER_TO_SIZE(b)));
+}
+
+/*
+ * Write the phases not yet reported as lines of "startup phase
+ * end_usec duration_usec" and, once, the widget types as lines of
+ * "widget type count usec", all separated by tabs
+ */
+static void
+startup_report(void)
+{
+        GList *types, *t;
+        struct type_cost *tc;
+
+        if (startup.report == NULL)
+                return;
+        for (; startup.reported < startup.n; startup.reported++)
+                fprintf(startup.report, "startup\t%s\t%ld\t%ld\n",
+                        startup.phase[startup.reported],
+                        startup.usec[startup.reported],
+                        startup.usec[startup.reported] -
+                        (startup.reported > 0 ? startup.usec[startup.reported - 1] : 0));
+        if (startup.types != NULL) {
+                types = g_list_sort(g_hash_table_get_keys(startup.types),
+                                    cmp_type_names);
+                for (t = types; t != NULL; t = t->next) {
+                        tc = g_hash_table_lookup(startup.types, t->data);
+                        fprintf(startup.report, "widget\t%s\t%u\t%lld\n",
+                                g_type_name(GPOINTER_TO_SIZE(t->data)),
+                                tc->count, tc->nsec / 1000);
+                }
+                g_list_free(types);
+                g_hash_table_destroy(startup.types);
+                startup.types = NULL;
+        }
+        fflush(startup.report);
+}
+
+/*
+ * Call fn(obj, data) for each obj in objects, charging the time taken
+ * to the type of obj if startup is being timed
+ */
+static void
+foreach_timed(GSList *objects, GFunc fn, gpointer data)
+{
+        gpointer type;
+        long long int nsec;
+        struct timespec start, end;
+        struct type_cost *tc;
+
+        if (startup.types == NULL) {
+                g_slist_foreach(objects, fn, data);
+                return;
+        }
+        for (; objects != NULL; objects = objects->next) {
+                clock_gettime(CLOCK_MONOTONIC, &start);
+                fn(objects->data, data);
+                clock_gettime(CLOCK_MONOTONIC, &end);
+                nsec = (end.tv_sec - start.tv_sec) * 1000000000LL +
+                        end.tv_nsec - start.tv_nsec;
+                type = GSIZE_TO_POINTER(G_OBJECT_TYPE(objects->data));
+                if ((tc = g_hash_table_lookup(startup.types, type)) == NULL) {
+                        if ((tc = malloc(sizeof(*tc))) == NULL)
+                                OOM_ABORT;
+                        tc->count = 0;
+                        tc->nsec = 0;
+                        g_hash_table_insert(startup.types, type, tc);
+                }
+                tc->count++;
+                tc->nsec += nsec;
+        }
+}
+
+/*
+ * Callback that notes when the main window has been painted for the
+ * first time
+ */
+static gboolean
+cb_first_paint(GtkWidget *widget, cairo_t *cr, gpointer data)
+{
+        (void) cr;
+        (void) data;
+        startup_mark("first_paint");
+        startup_report();
+        g_signal_handlers_disconnect_by_func(widget, cb_first_paint, NULL);
+        return FALSE;
+}
+
 static bool
 has_suffix(const char *s, const char *suffix)
 {
@@ -410,20 +589,119 @@ obj_sans_suffix(GtkBuilder *builder, const char *suffix, const char *name)
 }
 
 /*
- * Read UI definition from ui_file; give up on errors
+ * UI definitions read in advance by the zygote server (option -Z)
+ */
+struct preloaded_ui {
+        struct preloaded_ui *next;
+        char *path;             /* absolute */
+        char *xml;
+        off_t size;
+        struct timespec mtime;
+};
+
+static struct preloaded_ui *preloaded_uis = NULL;
+
+/*
+ * Keep the contents of ui_file in memory; give up on errors
+ */
+static void
+preload_ui_file(const char *ui_file)
+{
+        FILE *f = NULL;
+        struct preloaded_ui *p;
+        struct stat sb;
+
+        if ((p = malloc(sizeof(*p))) == NULL)
+                OOM_ABORT;
+        if ((p->path = realpath(ui_file, NULL)) == NULL ||
+            (f = fopen(p->path, "r")) == NULL ||
+            fstat(fileno(f), &sb) != 0)
+                bye(EXIT_FAILURE, stderr, "preloading %s: %s\n",
+                    ui_file, strerror(errno));
+        if ((p->xml = malloc(sb.st_size + 1)) == NULL)
+                OOM_ABORT;
+        if (fread(p->xml, 1, sb.st_size, f) != (size_t) sb.st_size)
+                bye(EXIT_FAILURE, stderr, "preloading %s: short read\n",
+                    ui_file);
+        fclose(f);
+        p->xml[sb.st_size] = '\0';
+        p->size = sb.st_size;
+        p->mtime = sb.st_mtim;
+        p->next = preloaded_uis;
+        preloaded_uis = p;
+}
+
+/*
+ * The preloaded contents of ui_file if they are still current, or NULL
+ */
+static const char *
+preloaded_ui(const char *ui_file)
+{
+        char *path;
+        struct preloaded_ui *p;
+        struct stat sb;
+
+        if (preloaded_uis == NULL || (path = realpath(ui_file, NULL)) == NULL)
+                return NULL;
+        for (p = preloaded_uis; p != NULL; p = p->next)
+                if (eql(p->path, path))
+                        break;
+        free(path);
+        if (p == NULL || stat(p->path, &sb) != 0 || sb.st_size != p->size ||
+            sb.st_mtim.tv_sec != p->mtime.tv_sec ||
+            sb.st_mtim.tv_nsec != p->mtime.tv_nsec)
+                return NULL;
+        return p->xml;
+}
+
+/*
+ * Read UI definition from ui_file, or take it from memory if it has
+ * been preloaded; give up on errors
  */
 static GtkBuilder *
 builder_from_file(char *ui_file)
 {
         GError *error = NULL;
         GtkBuilder *b;
+        const char *xml;
 
         b = gtk_builder_new();
-        if (gtk_builder_add_from_file(b, ui_file, &error) == 0)
+        if ((xml = preloaded_ui(ui_file)) != NULL) {
+                if (gtk_builder_add_from_string(b, xml, -1, &error) == 0)
+                        bye(EXIT_FAILURE, stderr, "%s\n", error->message);
+        } else if (gtk_builder_add_from_file(b, ui_file, &error) == 0)
                 bye(EXIT_FAILURE, stderr, "%s\n", error->message);
         return b;
 }
 
+/*
+ * Replace the stylesheet shared by all widgets with the contents of
+ * css_file.  Return false on errors, which are described in *error;
+ * the current stylesheet stays in place then.
+ */
+static bool
+load_stylesheet(const char *css_file, GError **error)
+{
+        static GtkCssProvider *stylesheet = NULL;
+        GtkCssProvider *fresh = gtk_css_provider_new();
+        GdkScreen *screen = gdk_screen_get_default();
+
+        if (!gtk_css_provider_load_from_path(fresh, css_file, error)) {
+                g_object_unref(fresh);
+                return false;
+        }
+        if (stylesheet != NULL) {
+                gtk_style_context_remove_provider_for_screen(
+                        screen, GTK_STYLE_PROVIDER(stylesheet));
+                g_object_unref(stylesheet);
+        }
+        stylesheet = fresh;
+        gtk_style_context_add_provider_for_screen(
+                screen, GTK_STYLE_PROVIDER(stylesheet),
+                GTK_STYLE_PROVIDER_PRIORITY_APPLICATION);
+        return true;
+}
+
 /*
  * Return the id attribute of widget
  */
@@ -448,45 +726,238 @@ find_main_window(GtkBuilder *builder)
 }
 
 /*
- * Store a line from stream s into buf, which should have been malloc'd
- * to bufsize.  Enlarge buf and bufsize if necessary.
+ * Streams using length-prefixed messages (option -B) rather than
+ * escaped lines
+ */
+static FILE *framed_in = NULL, *framed_out = NULL;
+
+/*
+ * Input stream whose contents are read in large chunks and split
+ * into lines or frames in user space
+ */
+struct reader {
+        int fd;
+        bool eof;
+        bool framed;            /* input comes as length-prefixed frames */
+        size_t pos;             /* next unread byte in buf */
+        size_t len;             /* number of valid bytes in buf */
+        size_t size;            /* allocated size of buf; >= RDBUFLEN */
+        char *buf;
+        struct client *client;  /* socket client it belongs to, if any */
+        struct ui_data *txn;    /* first of the commands collected */
+                                /* since begin, or NULL */
+        struct ui_data **txn_end; /* where to append to txn */
+        size_t txn_len;         /* number of commands in txn */
+};
+
+static void
+reader_init(struct reader *r, int fd, bool framed)
+{
+        r->fd = fd;
+        r->eof = false;
+        r->framed = framed;
+        r->pos = r->len = 0;
+        r->size = RDBUFLEN;
+        r->client = NULL;
+        r->txn = NULL;
+        if ((r->buf = malloc(r->size)) == NULL)
+                OOM_ABORT;
+}
+
+static void
+reader_free(struct reader *r)
+{
+        free(r->buf);
+        r->buf = NULL;
+}
+
+/*
+ * Refill r's buffer from its file descriptor, blocking if necessary.
+ * Return false on end of file or on errors.
+ */
+static bool
+fill_reader(struct reader *r)
+{
+        ssize_t n;
+
+        if (r->eof)
+                return false;
+        do
+                n = read(r->fd, r->buf, RDBUFLEN);
+        while (n < 0 && errno == EINTR);
+        if (n <= 0) {
+                r->eof = true;
+                return false;
+        }
+        r->pos = 0;
+        r->len = n;
+        return true;
+}
+
+/*
+ * Store a line from reader r into buf, which should have been
+ * malloc'd to bufsize.  Enlarge buf and bufsize if necessary.  Undo
+ * the escaping of newlines, carriage returns, and backslashes.
  */
 static size_t
-read_buf(FILE *s, char **buf, size_t *bufsize)
+read_buf(struct reader *r, char **buf, size_t *bufsize)
 {
-        bool esc = false;
-        fd_set rfds;
-        int c;
-        int ifd = fileno(s);
-        size_t i = 0;
+        bool esc = false, eol = false;
+        char *p, *nl;
+        size_t i = 0, j, n;
 
-        FD_ZERO(&rfds);
-        FD_SET(ifd, &rfds);
-        for (;;) {
-                select(ifd + 1, &rfds, NULL, NULL, NULL);
-                c = getc(s);
-                if (c == '\n' || feof(s))
+        while (!eol) {
+                if (r->pos >= r->len && !fill_reader(r))
                         break;
-                if (i >= *bufsize - 1)
+                p = r->buf + r->pos;
+                n = r->len - r->pos;
+                if ((nl = memchr(p, '\n', n)) != NULL) {
+                        n = nl - p;
+                        eol = true;
+                }
+                r->pos += n + eol;
+                while (i + n >= *bufsize)
                         if ((*buf = realloc(*buf, *bufsize *= 2)) == NULL)
                                 OOM_ABORT;
-                if (esc) {
-                        esc = false;
-                        switch (c) {
-                        case 'n': (*buf)[i++] = '\n'; break;
-                        case 'r': (*buf)[i++] = '\r'; break;
-                        default: (*buf)[i++] = c; break;
-                        }
-                } else if (c == '\\')
-                        esc = true;
-                else
-                        (*buf)[i++] = c;
+                if (!esc && memchr(p, '\\', n) == NULL) {
+                        memcpy(*buf + i, p, n);
+                        i += n;
+                        continue;
+                }
+                for (j = 0; j < n; j++)
+                        if (esc) {
+                                esc = false;
+                                switch (p[j]) {
+                                case 'n': (*buf)[i++] = '\n'; break;
+                                case 'r': (*buf)[i++] = '\r'; break;
+                                default: (*buf)[i++] = p[j]; break;
+                                }
+                        } else if (p[j] == '\\')
+                                esc = true;
+                        else
+                                (*buf)[i++] = p[j];
         }
         (*buf)[i] = '\0';
         return i;
 }
 
-
+
+/*
+ * Append whatever can be read from r's file descriptor without
+ * blocking to r's buffer, enlarging the buffer when an incomplete
+ * command fills it.  Return false on end of file or on errors.
+ */
+static bool
+feed_reader(struct reader *r)
+{
+        ssize_t n;
+
+        if (r->pos > 0) {
+                memmove(r->buf, r->buf + r->pos, r->len - r->pos);
+                r->len -= r->pos;
+                r->pos = 0;
+        }
+        if (r->len == r->size &&
+            (r->buf = realloc(r->buf, r->size *= 2)) == NULL)
+                OOM_ABORT;
+        do
+                n = read(r->fd, r->buf + r->len, r->size - r->len);
+        while (n < 0 && errno == EINTR);
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+                return true;
+        if (n <= 0) {
+                r->eof = true;
+                return false;
+        }
+        r->len += n;
+        return true;
+}
+
+/*
+ * True if r's buffer holds a complete command, so that reading it
+ * won't block
+ */
+static bool
+reader_ready(struct reader *r)
+{
+        unsigned char *h = (unsigned char *) r->buf + r->pos;
+        size_t avail = r->len - r->pos, n;
+
+        if (!r->framed)
+                return memchr(h, '\n', avail) != NULL;
+        if (avail < 4)
+                return false;
+        n = (size_t) h[0] << 24 | (size_t) h[1] << 16 |
+                (size_t) h[2] << 8 | (size_t) h[3];
+        /* Oversized frames are rejected without being buffered */
+        return n > MAX_FRAME_LEN || avail - 4 >= n;
+}
+
+/*
+ * Copy n bytes from reader r into buf, or skip them if buf is NULL.
+ * Return false if end of file comes first.
+ */
+static bool
+read_bytes(struct reader *r, char *buf, size_t n)
+{
+        size_t k;
+
+        while (n > 0) {
+                if (r->pos >= r->len && !fill_reader(r))
+                        return false;
+                k = MIN(n, r->len - r->pos);
+                if (buf != NULL) {
+                        memcpy(buf, r->buf + r->pos, k);
+                        buf += k;
+                }
+                r->pos += k;
+                n -= k;
+        }
+        return true;
+}
+
+/*
+ * Store a frame from reader r into buf, which should have been
+ * malloc'd to bufsize.  Enlarge buf and bufsize if necessary.  A frame
+ * is a 4-byte big-endian payload length followed by the payload,
+ * which is taken as it is.  Return the payload length; a '\0' is
+ * appended to the payload.  Frames longer than MAX_FRAME_LEN are
+ * skipped and read as empty ones; since a socket client's frames
+ * can't be skipped without blocking, such a client is cut off.
+ */
+static size_t
+read_frame(struct reader *r, char **buf, size_t *bufsize)
+{
+        unsigned char h[4];
+        size_t n;
+
+        if (read_bytes(r, (char *) h, sizeof(h))) {
+                n = (size_t) h[0] << 24 | (size_t) h[1] << 16 |
+                        (size_t) h[2] << 8 | (size_t) h[3];
+                if (n > MAX_FRAME_LEN) {
+                        fprintf(stderr, "ignoring frame of %zu bytes\n", n);
+                        if (r->client != NULL) {
+                                fprintf(stderr, "disconnecting client\n");
+                                r->pos = r->len;
+                                r->eof = true;
+                        } else
+                                read_bytes(r, NULL, n);
+                        n = 0;
+                } else {
+                        while (n >= *bufsize)
+                                if ((*buf = realloc(*buf,
+                                                    *bufsize *= 2)) == NULL)
+                                        OOM_ABORT;
+                        if (!read_bytes(r, *buf, n))
+                                n = 0;
+                }
+        } else
+                n = 0;
+        (*buf)[n] = '\0';
+        return n;
+}
+
+
 /*
  * ============================================================
  * Receiving feedback from the GUI
@@ -504,26 +975,53 @@ gtk_show_uri(GdkScreen *s, const gchar *uri, guint32 ts, GError **e)
         return TRUE;
 }
 
+/*
+ * Write a message to o as a frame: its length as a 4-byte big-endian
+ * number, followed by "<w_id>:<tag> <data ...>" without any escaping
+ */
+static void
+put_frame(FILE *o, const char *w_id, const char *tag, va_list ap)
+{
+        char *data;
+        size_t len = strlen(w_id) + strlen(tag) + 2;
+        va_list aq;
+
+        va_copy(aq, ap);
+        while ((data = va_arg(aq, char *)) != NULL)
+                len += strlen(data);
+        va_end(aq);
+        putc(len >> 24 & 0xff, o);
+        putc(len >> 16 & 0xff, o);
+        putc(len >> 8 & 0xff, o);
+        putc(len & 0xff, o);
+        fprintf(o, "%s:%s ", w_id, tag);
+        while ((data = va_arg(ap, char *)) != NULL)
+                fputs(data, o);
+        fflush(o);
+}
+
 static void
-send_msg_to(FILE* o, GtkBuildable *obj, const char *tag, va_list ap)
+send_msg_to(FILE* o, const char *w_id, const char *tag, va_list ap)
 {
         char *data;
-        const char *w_id = widget_id(obj);
         fd_set wfds;
         int ofd = fileno(o);
         struct timeval timeout = {1, 0};
 
         FD_ZERO(&wfds);
         FD_SET(ofd, &wfds);
-        if (select(ofd + 1, NULL, &wfds, NULL, &timeout) == 1) {
+        if (select(ofd + 1, NULL, &wfds, NULL, &timeout) != 1)
+                fprintf(stderr,
+                        "send error; discarding feedback message %s:%s\n",
+                        w_id, tag);
+        else if (o == framed_out)
+                put_frame(o, w_id, tag, ap);
+        else {
                 fprintf(o, "%s:%s ", w_id, tag);
                 while ((data = va_arg(ap, char *)) != NULL)
                         fputs_escaped(data, o);
                 putc('\n', o);
-        } else
-                fprintf(stderr,
-                        "send error; discarding feedback message %s:%s\n",
-                        w_id, tag);
+        }
 }
 
 /*
@@ -537,7 +1035,21 @@ send_msg(FILE *o, GtkBuildable *obj, const char *tag, ...)
         va_list ap;
 
         va_start(ap, tag);
-        send_msg_to(o, obj, tag, ap);
+        send_msg_to(o, widget_id(obj), tag, ap);
+        va_end(ap);
+}
+
+/*
+ * Send a message in the format of send_msg() on behalf of an id that
+ * need not belong to any widget
+ */
+static void
+send_msg_by_id(FILE *o, const char *w_id, const char *tag, ...)
+{
+        va_list ap;
+
+        va_start(ap, tag);
+        send_msg_to(o, w_id, tag, ap);
         va_end(ap);
 }
 
@@ -552,7 +1064,7 @@ send_msg_as_cmd(FILE *o, GtkBuildable *obj, const char *tag, ...)
         va_list ap;
 
         va_start(ap, tag);
-        send_msg_to(o, obj, "set", ap);
+        send_msg_to(o, widget_id(obj), "set", ap);
         va_end(ap);
 }
 
@@ -564,24 +1076,305 @@ struct info {
         FILE *fin;              /* command input */
         FILE *flog;             /* logging output */
         GtkBuilder *builder;    /* to be read from .ui file */
+        GHashTable *widgets;    /* widget id -> struct widget_entry */
         GObject *obj;
         GtkTreeModel *model;
+        GHashTable *columns;    /* of tree views, while initializing */
         char *txt;
         char *data;
 };
 
+/*
+ * Actions known to any of the widgets, interned once per command by
+ * action_id() so that updaters can switch on an integer.  Keep
+ * action_names[] sorted; it is searched by bisection.
+ */
+enum action {
+        ACT_NONE,               /* not a known action */
+        ACT_ADD_CLASS,
+        ACT_APPEND_TEXT,
+        ACT_ARC,
+        ACT_ARC_NEGATIVE,
+        ACT_BEGIN,
+        ACT_BLOCK,
+        ACT_CANVAS,
+        ACT_CLEAR,
+        ACT_CLEAR_MARKS,
+        ACT_CLOSE_PATH,
+        ACT_COLLAPSE,
+        ACT_COMMIT,
+        ACT_CURVE_TO,
+        ACT_DECIMATE,
+        ACT_DELETE,
+        ACT_EXPAND,
+        ACT_EXPAND_ALL,
+        ACT_FILL,
+        ACT_FILL_PRESERVE,
+        ACT_FORCE,
+        ACT_FULLSCREEN,
+        ACT_GRAB_FOCUS,
+        ACT_HSCROLL,
+        ACT_HSCROLL_TO_RANGE,
+        ACT_ID,
+        ACT_INSERT_AT_CURSOR,
+        ACT_INSERT_ROW,
+        ACT_INSERT_TEXT,
+        ACT_LAYER,
+        ACT_LINE_TO,
+        ACT_LOAD,
+        ACT_MAIN_QUIT,
+        ACT_MARK_DAY,
+        ACT_MOVE,
+        ACT_MOVE_ROW,
+        ACT_MOVE_TO,
+        ACT_PING,
+        ACT_PLACE_CURSOR,
+        ACT_PLACE_CURSOR_AT_LINE,
+        ACT_POLYGON,
+        ACT_POLYLINE,
+        ACT_POLYLINE_FILE,
+        ACT_POP,
+        ACT_POP_ID,
+        ACT_POPDOWN,
+        ACT_POPUP,
+        ACT_PREPEND_TEXT,
+        ACT_PRINT,
+        ACT_PUSH,
+        ACT_PUSH_ID,
+        ACT_RECTANGLE,
+        ACT_REL_CURVE_TO,
+        ACT_REL_LINE_TO,
+        ACT_REL_MOVE_FOR,
+        ACT_REL_MOVE_TO,
+        ACT_REL_POLYLINE,
+        ACT_REMOVE,
+        ACT_REMOVE_ALL,
+        ACT_REMOVE_ALL_ID,
+        ACT_REMOVE_CLASS,
+        ACT_REMOVE_ROW,
+        ACT_RESIZE,
+        ACT_ROTATE,
+        ACT_SAVE,
+        ACT_SCALE,
+        ACT_SCROLL,
+        ACT_SCROLL_TO_CURSOR,
+        ACT_SELECT_DATE,
+        ACT_SERIES,
+        ACT_SERIES_ADD,
+        ACT_SET,
+        ACT_SET_ACTIVE,
+        ACT_SET_COLOR,
+        ACT_SET_CURRENT_NAME,
+        ACT_SET_CURRENT_PAGE,
+        ACT_SET_CURSOR,
+        ACT_SET_DASH,
+        ACT_SET_EXPANDED,
+        ACT_SET_FILENAME,
+        ACT_SET_FILL_LEVEL,
+        ACT_SET_FONT_FACE,
+        ACT_SET_FONT_NAME,
+        ACT_SET_FONT_SIZE,
+        ACT_SET_FRACTION,
+        ACT_SET_FROM_FILE,
+        ACT_SET_FROM_ICON_NAME,
+        ACT_SET_INCREMENTS,
+        ACT_SET_LABEL,
+        ACT_SET_LINE_CAP,
+        ACT_SET_LINE_JOIN,
+        ACT_SET_LINE_WIDTH,
+        ACT_SET_PLACEHOLDER_TEXT,
+        ACT_SET_RANGE,
+        ACT_SET_SENSITIVE,
+        ACT_SET_SIZE_REQUEST,
+        ACT_SET_SOURCE_RGBA,
+        ACT_SET_TEXT,
+        ACT_SET_TITLE,
+        ACT_SET_TOOLTIP_TEXT,
+        ACT_SET_VALUE,
+        ACT_SET_VISIBLE,
+        ACT_SET_VISITED,
+        ACT_SHOW_TEXT,
+        ACT_SNAPSHOT,
+        ACT_START,
+        ACT_STATS,
+        ACT_STOP,
+        ACT_STROKE,
+        ACT_STROKE_PRESERVE,
+        ACT_STYLE,
+        ACT_STYLESHEET,
+        ACT_SUBSCRIBE,
+        ACT_TILES,
+        ACT_TRANSFORM,
+        ACT_TRANSLATE,
+        ACT_UNFULLSCREEN,
+        ACT_UNSUBSCRIBE,
+        ACT_VSCROLL,
+        ACT_VSCROLL_TO_RANGE,
+};
+static const char *action_names[] = {
+        [ACT_ADD_CLASS] = "add_class",
+        [ACT_APPEND_TEXT] = "append_text",
+        [ACT_ARC] = "arc",
+        [ACT_ARC_NEGATIVE] = "arc_negative",
+        [ACT_BEGIN] = "begin",
+        [ACT_BLOCK] = "block",
+        [ACT_CANVAS] = "canvas",
+        [ACT_CLEAR] = "clear",
+        [ACT_CLEAR_MARKS] = "clear_marks",
+        [ACT_CLOSE_PATH] = "close_path",
+        [ACT_COLLAPSE] = "collapse",
+        [ACT_COMMIT] = "commit",
+        [ACT_CURVE_TO] = "curve_to",
+        [ACT_DECIMATE] = "decimate",
+        [ACT_DELETE] = "delete",
+        [ACT_EXPAND] = "expand",
+        [ACT_EXPAND_ALL] = "expand_all",
+        [ACT_FILL] = "fill",
+        [ACT_FILL_PRESERVE] = "fill_preserve",
+        [ACT_FORCE] = "force",
+        [ACT_FULLSCREEN] = "fullscreen",
+        [ACT_GRAB_FOCUS] = "grab_focus",
+        [ACT_HSCROLL] = "hscroll",
+        [ACT_HSCROLL_TO_RANGE] = "hscroll_to_range",
+        [ACT_ID] = "id",
+        [ACT_INSERT_AT_CURSOR] = "insert_at_cursor",
+        [ACT_INSERT_ROW] = "insert_row",
+        [ACT_INSERT_TEXT] = "insert_text",
+        [ACT_LAYER] = "layer",
+        [ACT_LINE_TO] = "line_to",
+        [ACT_LOAD] = "load",
+        [ACT_MAIN_QUIT] = "main_quit",
+        [ACT_MARK_DAY] = "mark_day",
+        [ACT_MOVE] = "move",
+        [ACT_MOVE_ROW] = "move_row",
+        [ACT_MOVE_TO] = "move_to",
+        [ACT_PING] = "ping",
+        [ACT_PLACE_CURSOR] = "place_cursor",
+        [ACT_PLACE_CURSOR_AT_LINE] = "place_cursor_at_line",
+        [ACT_POLYGON] = "polygon",
+        [ACT_POLYLINE] = "polyline",
+        [ACT_POLYLINE_FILE] = "polyline_file",
+        [ACT_POP] = "pop",
+        [ACT_POP_ID] = "pop_id",
+        [ACT_POPDOWN] = "popdown",
+        [ACT_POPUP] = "popup",
+        [ACT_PREPEND_TEXT] = "prepend_text",
+        [ACT_PRINT] = "print",
+        [ACT_PUSH] = "push",
+        [ACT_PUSH_ID] = "push_id",
+        [ACT_RECTANGLE] = "rectangle",
+        [ACT_REL_CURVE_TO] = "rel_curve_to",
+        [ACT_REL_LINE_TO] = "rel_line_to",
+        [ACT_REL_MOVE_FOR] = "rel_move_for",
+        [ACT_REL_MOVE_TO] = "rel_move_to",
+        [ACT_REL_POLYLINE] = "rel_polyline",
+        [ACT_REMOVE] = "remove",
+        [ACT_REMOVE_ALL] = "remove_all",
+        [ACT_REMOVE_ALL_ID] = "remove_all_id",
+        [ACT_REMOVE_CLASS] = "remove_class",
+        [ACT_REMOVE_ROW] = "remove_row",
+        [ACT_RESIZE] = "resize",
+        [ACT_ROTATE] = "rotate",
+        [ACT_SAVE] = "save",
+        [ACT_SCALE] = "scale",
+        [ACT_SCROLL] = "scroll",
+        [ACT_SCROLL_TO_CURSOR] = "scroll_to_cursor",
+        [ACT_SELECT_DATE] = "select_date",
+        [ACT_SERIES] = "series",
+        [ACT_SERIES_ADD] = "series_add",
+        [ACT_SET] = "set",
+        [ACT_SET_ACTIVE] = "set_active",
+        [ACT_SET_COLOR] = "set_color",
+        [ACT_SET_CURRENT_NAME] = "set_current_name",
+        [ACT_SET_CURRENT_PAGE] = "set_current_page",
+        [ACT_SET_CURSOR] = "set_cursor",
+        [ACT_SET_DASH] = "set_dash",
+        [ACT_SET_EXPANDED] = "set_expanded",
+        [ACT_SET_FILENAME] = "set_filename",
+        [ACT_SET_FILL_LEVEL] = "set_fill_level",
+        [ACT_SET_FONT_FACE] = "set_font_face",
+        [ACT_SET_FONT_NAME] = "set_font_name",
+        [ACT_SET_FONT_SIZE] = "set_font_size",
+        [ACT_SET_FRACTION] = "set_fraction",
+        [ACT_SET_FROM_FILE] = "set_from_file",
+        [ACT_SET_FROM_ICON_NAME] = "set_from_icon_name",
+        [ACT_SET_INCREMENTS] = "set_increments",
+        [ACT_SET_LABEL] = "set_label",
+        [ACT_SET_LINE_CAP] = "set_line_cap",
+        [ACT_SET_LINE_JOIN] = "set_line_join",
+        [ACT_SET_LINE_WIDTH] = "set_line_width",
+        [ACT_SET_PLACEHOLDER_TEXT] = "set_placeholder_text",
+        [ACT_SET_RANGE] = "set_range",
+        [ACT_SET_SENSITIVE] = "set_sensitive",
+        [ACT_SET_SIZE_REQUEST] = "set_size_request",
+        [ACT_SET_SOURCE_RGBA] = "set_source_rgba",
+        [ACT_SET_TEXT] = "set_text",
+        [ACT_SET_TITLE] = "set_title",
+        [ACT_SET_TOOLTIP_TEXT] = "set_tooltip_text",
+        [ACT_SET_VALUE] = "set_value",
+        [ACT_SET_VISIBLE] = "set_visible",
+        [ACT_SET_VISITED] = "set_visited",
+        [ACT_SHOW_TEXT] = "show_text",
+        [ACT_SNAPSHOT] = "snapshot",
+        [ACT_START] = "start",
+        [ACT_STATS] = "stats",
+        [ACT_STOP] = "stop",
+        [ACT_STROKE] = "stroke",
+        [ACT_STROKE_PRESERVE] = "stroke_preserve",
+        [ACT_STYLE] = "style",
+        [ACT_STYLESHEET] = "stylesheet",
+        [ACT_SUBSCRIBE] = "subscribe",
+        [ACT_TILES] = "tiles",
+        [ACT_TRANSFORM] = "transform",
+        [ACT_TRANSLATE] = "translate",
+        [ACT_UNFULLSCREEN] = "unfullscreen",
+        [ACT_UNSUBSCRIBE] = "unsubscribe",
+        [ACT_VSCROLL] = "vscroll",
+        [ACT_VSCROLL_TO_RANGE] = "vscroll_to_range",
+};
+
+static int
+cmp_action(const void *name, const void *entry)
+{
+        return strcmp(name, *(const char * const *) entry);
+}
+
+/*
+ * Map action name to its enum action; ACT_NONE if unknown
+ */
+static enum action
+action_id(const char *name)
+{
+        const char **p;
+
+        p = bsearch(name, action_names + 1,
+                    sizeof(action_names) / sizeof(*action_names) - 1,
+                    sizeof(*action_names), cmp_action);
+        return p == NULL ? ACT_NONE : (enum action) (p - action_names);
+}
+
 /*
  * Data to be passed to and from the GTK main loop
  */
 struct ui_data {
         void (*fn)(struct ui_data *);
         GObject *obj;
-        char *action;
+        char *id;
+        enum action act;
         char *data;
+        const char *bin;        /* binary arguments of a frame, if any */
+        size_t bin_len;
         char *cmd;
-        char *cmd_tokens;
+        size_t cmd_size;        /* allocated size of cmd */
         GType type;
         struct info *args;
+        bool superseded;        /* by a later command (option -C) */
+        struct ui_data *supersedes; /* waiting command this one replaces */
+        unsigned long long int client; /* serial number of the socket */
+                                /* client it came from; 0: none */
+        struct ui_data *staged; /* of a commit: commands to execute */
+        struct ui_data **staged_end; /* next pointer of the last one */
+        struct ui_data *next;   /* in list of spare or staged records */
 };
 
 /*
@@ -598,8 +1391,10 @@ info_new_full(FILE *stream, GObject *obj, GtkTreeModel *model, char *txt)
         ar->fin = NULL;
         ar->flog = NULL;
         ar->builder = NULL;
+        ar->widgets = NULL;
         ar->obj = obj;
         ar->model = model;
+        ar->columns = NULL;
         ar->txt = txt;
         ar->data = NULL;
         return ar;
@@ -951,12 +1746,17 @@ enum cairo_fn {
         FILL_PRESERVE,
         LINE_TO,
         MOVE_TO,
+        POLYGON,
+        POLYLINE,
+        POLYLINE_FILE,
         RECTANGLE,
         REL_CURVE_TO,
         REL_LINE_TO,
         REL_MOVE_TO,
+        REL_POLYLINE,
         REL_MOVE_FOR,
         RESET_CTM,
+        SERIES,
         SET_DASH,
         SET_FONT_FACE,
         SET_FONT_SIZE,
@@ -997,11 +1797,50 @@ enum draw_op_policy {
 struct draw_op {
         struct draw_op *next;
         struct draw_op *prev;
+        struct draw_op *same_id; /* another element with the same id */
+        unsigned long long int rank; /* ascending along the list */
         unsigned long long int id;
         unsigned long long int before;
         enum draw_op_policy policy;
         enum cairo_fn op;
         void *op_args;
+        bool dirty;             /* changed since extents were computed */
+        bool has_extents;
+        cairo_rectangle_int_t extents; /* in device space; painting */
+                                       /* operations only */
+};
+
+/*
+ * The drawing of a GtkDrawingArea: a list of draw_ops, indexed by id.
+ * The index leads to the element of each id that comes first in the
+ * list; the others are chained to it by their same_id pointers.
+ *
+ * Underneath, there may be named layers, each being a drawing of its
+ * own that is rendered into a cached surface.  At the very bottom,
+ * there may be a persistent canvas which drawing commands are painted
+ * onto right away instead of being kept as draw_ops.
+ */
+struct drawing {
+        struct draw_op *first;
+        struct draw_op *last;
+        GHashTable *ids;
+        cairo_region_t *damage; /* left by elements no longer there */
+        bool damage_all;
+        bool changed;           /* since last refresh */
+        bool refresh_pending;
+        struct drawing *layers; /* bottom first */
+        struct drawing *target; /* where drawing commands go */
+        char *name;             /* of a layer */
+        struct drawing *next;   /* layer above */
+        cairo_surface_t *cache; /* rendered layer, or NULL */
+        int cache_width;
+        int cache_height;
+        cairo_surface_t *canvas; /* or NULL */
+        cairo_t *canvas_cr;     /* keeps state between commands */
+        bool decimate;          /* long paths, in all layers */
+        int tile_size;          /* for rendering in parallel, or 0 */
+        unsigned long long int files_version; /* of vertex files, as */
+                                /* last caught up with */
 };
 
 /*
@@ -1047,6 +1886,71 @@ struct set_dash_args {
         double dashes[];
 };
 
+/*
+ * The vertices of a long path reduced to the first, lowest, highest
+ * and last one of each run falling into the same pixel column, as
+ * seen through matrix.  If that's no real reduction, coords is NULL.
+ */
+struct lod {
+        double xx, xy;          /* how the user space the reduction */
+        double phase;           /* was made in maps x to device */
+                                /* columns, up to whole pixels */
+        size_t n;               /* number of vertices reduced */
+        size_t num_points;
+        double *coords;
+};
+
+struct polyline_args {
+        struct lod *lod;
+        int num_coords;
+        double coords[];        /* x1, y1, x2, y2, ... */
+};
+
+/*
+ * A file of native-endian doubles x1, y1, x2, y2, ... mapped into
+ * memory and shared by all drawing operations referring to it
+ */
+struct vertex_file {
+        char *path;
+        int refs;
+        int fd;                 /* kept open for following its size */
+        const double *coords;
+        size_t size;            /* in bytes, as of the last check; */
+                                /* never more than mapped */
+        size_t mapped;          /* length of the mapping */
+        struct timespec mtime;  /* as of the last check */
+        unsigned long long int version; /* of the last change seen */
+        dev_t dev;
+        ino_t ino;
+};
+
+/*
+ * A time series: a ring buffer of samples y, drawn at equal distances
+ * across the box x, y, width, height, the newest at its right edge;
+ * ymin and ymax are at the bottom and top of the box, respectively
+ */
+struct series_args {
+        double x;
+        double y;
+        double width;
+        double height;
+        double ymin;
+        double ymax;
+        struct lod *lod;
+        int capacity;
+        int count;
+        int head;               /* where the next sample goes */
+        double samples[];
+};
+
+struct polyline_file_args {
+        struct lod *lod;
+        struct vertex_file *file;
+        unsigned long long int version; /* of file, as last drawn */
+        size_t offset;          /* in points */
+        size_t count;
+};
+
 struct set_font_face_args {
         cairo_font_slant_t slant;
         cairo_font_weight_t weight;
@@ -1082,26 +1986,344 @@ struct transform_args {
         cairo_matrix_t matrix;
 };
 
+/*
+ * Ways of getting at the i-th vertex of long paths
+ */
 static void
-draw(cairo_t *cr, enum cairo_fn op, void *op_args)
+polyline_point(const void *op_args, size_t i, double *x, double *y)
 {
-        switch (op) {
-        case LINE_TO: {
-                struct move_to_args *args = op_args;
+        const struct polyline_args *args = op_args;
 
-                cairo_line_to(cr, args->x, args->y);
-                break;
-        }
-        case REL_LINE_TO: {
-                struct move_to_args *args = op_args;
+        *x = args->coords[2 * i];
+        *y = args->coords[2 * i + 1];
+}
 
-                cairo_rel_line_to(cr, args->x, args->y);
-                break;
-        }
-        case MOVE_TO: {
-                struct move_to_args *args = op_args;
+static void
+polyline_file_point(const void *op_args, size_t i, double *x, double *y)
+{
+        const struct polyline_file_args *args = op_args;
 
-                cairo_move_to(cr, args->x, args->y);
+        *x = args->file->coords[2 * (args->offset + i)];
+        *y = args->file->coords[2 * (args->offset + i) + 1];
+}
+
+static void
+series_point(const void *op_args, size_t i, double *x, double *y)
+{
+        const struct series_args *args = op_args;
+        int k = args->capacity - args->count + i;
+
+        *x = args->x + k * args->width / (args->capacity - 1);
+        *y = args->y + args->height - args->height *
+                (args->samples[(args->head + k) % args->capacity] - args->ymin) /
+                (args->ymax - args->ymin);
+}
+
+/*
+ * Files mapped for polyline_file: the latest one by path, and all of
+ * them, including those replaced meanwhile.  Used inside gtk_main()
+ * only.
+ */
+static GHashTable *vertex_files = NULL;
+static GHashTable *mapped_vertex_files = NULL;
+
+/*
+ * Number of changes to vertex files seen so far; used inside
+ * gtk_main() only
+ */
+static unsigned long long int vertex_files_version = 0;
+
+/*
+ * Catch up with the current size of vertex file vf, mapping it anew
+ * if it has grown.  Reading vertices from beyond the end of a file
+ * that has shrunk would raise SIGBUS.  Note any change of size or
+ * modification time in vf->version.
+ */
+static void
+sync_vertex_file(struct vertex_file *vf)
+{
+        struct stat sb;
+        size_t old_size = vf->size;
+        void *addr;
+
+        if (fstat(vf->fd, &sb) != 0) {
+                vf->size = 0;
+                if (old_size != 0)
+                        vf->version = ++vertex_files_version;
+                return;
+        }
+        if (sb.st_mtim.tv_sec != vf->mtime.tv_sec ||
+            sb.st_mtim.tv_nsec != vf->mtime.tv_nsec) {
+                vf->mtime = sb.st_mtim;
+                vf->version = ++vertex_files_version;
+        }
+        if ((size_t) sb.st_size > vf->mapped &&
+            (addr = mmap(NULL, sb.st_size, PROT_READ, MAP_SHARED,
+                         vf->fd, 0)) != MAP_FAILED) {
+                if (vf->mapped > 0)
+                        munmap((void *) vf->coords, vf->mapped);
+                vf->coords = addr;
+                vf->mapped = sb.st_size;
+        }
+        vf->size = MIN((size_t) sb.st_size, vf->mapped);
+        if (vf->size != old_size)
+                vf->version = ++vertex_files_version;
+}
+
+/*
+ * Have all mapped vertex files catch up with their current sizes
+ * before drawing from them.  Runs inside gtk_main() while no tiles
+ * are being rendered.
+ */
+static void
+sync_vertex_files(void)
+{
+        GHashTableIter iter;
+        void *vf;
+
+        if (mapped_vertex_files == NULL)
+                return;
+        g_hash_table_iter_init(&iter, mapped_vertex_files);
+        while (g_hash_table_iter_next(&iter, &vf, NULL))
+                sync_vertex_file(vf);
+}
+
+/*
+ * A reference to the mapping of file path, which is made anew if
+ * another file has been put in its place since it was last mapped
+ */
+static struct vertex_file *
+get_vertex_file(const char *path)
+{
+        int fd;
+        struct stat sb;
+        struct vertex_file *vf;
+
+        if (vertex_files == NULL) {
+                vertex_files = g_hash_table_new(g_str_hash, g_str_equal);
+                mapped_vertex_files = g_hash_table_new(g_direct_hash,
+                                                       g_direct_equal);
+        }
+        if (stat(path, &sb) != 0)
+                return NULL;
+        if ((vf = g_hash_table_lookup(vertex_files, path)) != NULL &&
+            vf->dev == sb.st_dev && vf->ino == sb.st_ino) {
+                sync_vertex_file(vf);
+                vf->refs++;
+                return vf;
+        }
+        if ((fd = open(path, O_RDONLY)) < 0)
+                return NULL;
+        if (vf != NULL)         /* stale; left to those still using it */
+                g_hash_table_remove(vertex_files, path);
+        if ((vf = malloc(sizeof(*vf))) == NULL ||
+            (vf->path = strdup(path)) == NULL)
+                OOM_ABORT;
+        vf->refs = 1;
+        vf->fd = fd;
+        vf->coords = NULL;
+        vf->size = vf->mapped = 0;
+        vf->mtime = sb.st_mtim;
+        vf->version = 0;
+        vf->dev = sb.st_dev;
+        vf->ino = sb.st_ino;
+        sync_vertex_file(vf);
+        g_hash_table_insert(vertex_files, vf->path, vf);
+        g_hash_table_add(mapped_vertex_files, vf);
+        return vf;
+}
+
+static void
+release_vertex_file(struct vertex_file *vf)
+{
+        if (--vf->refs > 0)
+                return;
+        if (g_hash_table_lookup(vertex_files, vf->path) == vf)
+                g_hash_table_remove(vertex_files, vf->path);
+        g_hash_table_remove(mapped_vertex_files, vf);
+        if (vf->mapped > 0)
+                munmap((void *) vf->coords, vf->mapped);
+        close(vf->fd);
+        free(vf->path);
+        free(vf);
+}
+
+/*
+ * Find out how cr maps user space to device columns, device scale and
+ * offset included: x_device = xx * x + xy * y + x0, where only the
+ * fractional part of x0, phase, is of interest
+ */
+static void
+device_columns(cairo_t *cr, double *xx, double *xy, double *phase)
+{
+        double x0 = 0.0, y0 = 0.0, dy = 0.0;
+
+        *xx = 1.0;
+        cairo_user_to_device_distance(cr, xx, &dy);
+        *xy = 0.0;
+        dy = 1.0;
+        cairo_user_to_device_distance(cr, xy, &dy);
+        cairo_user_to_device(cr, &x0, &y0);
+        *phase = x0 - floor(x0);
+}
+
+/*
+ * Build *lod for the n vertices that point() gets from op_args
+ */
+static void
+decimate_points(cairo_t *cr, struct lod **lod, size_t n,
+                void (*point)(const void *, size_t, double *, double *),
+                const void *op_args)
+{
+        double x, y, dx = 0.0, dy = 0.0, ymin = 0.0, ymax = 0.0, col = 0.0;
+        size_t i, j, size = 64, run[4]; /* first, lowest, highest, last */
+        struct lod *l;
+
+        if ((l = *lod) == NULL) {
+                if ((l = *lod = malloc(sizeof(*l))) == NULL)
+                        OOM_ABORT;
+                l->coords = NULL;
+        }
+        free(l->coords);
+        device_columns(cr, &l->xx, &l->xy, &l->phase);
+        l->n = n;
+        if ((l->coords = malloc(size * 2 * sizeof(double))) == NULL)
+                OOM_ABORT;
+        l->num_points = 0;
+        for (i = 0; i <= n; i++) {
+                if (i < n) {
+                        point(op_args, i, &x, &y);
+                        dx = x;
+                        dy = y;
+                        cairo_user_to_device(cr, &dx, &dy);
+                        dx = floor(dx);
+                }
+                if (i > 0 && (i == n || dx != col)) { /* end of run */
+                        if (run[1] > run[2]) {
+                                j = run[1];
+                                run[1] = run[2];
+                                run[2] = j;
+                        }
+                        for (j = 0; j < 4; j++) {
+                                if (j > 0 && run[j] == run[j - 1])
+                                        continue;
+                                if (l->num_points == size &&
+                                    (l->coords = realloc(l->coords, (size *= 2) * 2 * sizeof(double))) == NULL)
+                                        OOM_ABORT;
+                                point(op_args, run[j],
+                                      l->coords + 2 * l->num_points,
+                                      l->coords + 2 * l->num_points + 1);
+                                l->num_points++;
+                        }
+                }
+                if (i == n)
+                        break;
+                if (i == 0 || dx != col) { /* start of run */
+                        col = dx;
+                        run[0] = run[1] = run[2] = run[3] = i;
+                        ymin = ymax = dy;
+                } else {
+                        if (dy < ymin) {
+                                ymin = dy;
+                                run[1] = i;
+                        }
+                        if (dy > ymax) {
+                                ymax = dy;
+                                run[2] = i;
+                        }
+                        run[3] = i;
+                }
+        }
+        if (l->num_points > n / 2) {
+                free(l->coords);
+                l->coords = NULL;
+        }
+}
+
+/*
+ * Protects reductions of long paths from rendering threads
+ */
+static pthread_mutex_t lod_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+ * Add to the path of cr a line through the n vertices that point()
+ * gets from op_args; if decimate, use or renew their cached reduction
+ * in *lod.  A reduction depends on how vertices fall into columns of
+ * device pixels, which whole-pixel translations, as between measuring
+ * and painting, don't change.
+ */
+static void
+draw_points(cairo_t *cr, struct lod **lod, bool decimate, size_t n,
+            void (*point)(const void *, size_t, double *, double *),
+            const void *op_args)
+{
+        double x, y, xx, xy, phase;
+        size_t i;
+
+        if (decimate) {
+                device_columns(cr, &xx, &xy, &phase);
+                pthread_mutex_lock(&lod_lock);
+                if (*lod == NULL || (*lod)->n != n ||
+                    (*lod)->xx != xx || (*lod)->xy != xy ||
+                    (*lod)->phase != phase)
+                        decimate_points(cr, lod, n, point, op_args);
+                if ((*lod)->coords != NULL) {
+                        for (i = 0; i < (*lod)->num_points; i++)
+                                if (i == 0)
+                                        cairo_move_to(cr, (*lod)->coords[0], (*lod)->coords[1]);
+                                else
+                                        cairo_line_to(cr, (*lod)->coords[2 * i], (*lod)->coords[2 * i + 1]);
+                        pthread_mutex_unlock(&lod_lock);
+                        return;
+                }
+                pthread_mutex_unlock(&lod_lock);
+        }
+        for (i = 0; i < n; i++) {
+                point(op_args, i, &x, &y);
+                if (i == 0)
+                        cairo_move_to(cr, x, y);
+                else
+                        cairo_line_to(cr, x, y);
+        }
+}
+
+/*
+ * Forget the reduced vertices of a long path
+ */
+static void
+free_lod(struct lod **lod)
+{
+        if (*lod != NULL) {
+                free((*lod)->coords);
+                free(*lod);
+                *lod = NULL;
+        }
+}
+
+/*
+ * Execute drawing operation op; long paths are reduced to what makes
+ * a visible difference if decimate
+ */
+static void
+draw(cairo_t *cr, enum cairo_fn op, void *op_args, bool decimate)
+{
+        switch (op) {
+        case LINE_TO: {
+                struct move_to_args *args = op_args;
+
+                cairo_line_to(cr, args->x, args->y);
+                break;
+        }
+        case REL_LINE_TO: {
+                struct move_to_args *args = op_args;
+
+                cairo_rel_line_to(cr, args->x, args->y);
+                break;
+        }
+        case MOVE_TO: {
+                struct move_to_args *args = op_args;
+
+                cairo_move_to(cr, args->x, args->y);
                 break;
         }
         case REL_MOVE_TO: {
@@ -1143,6 +2365,41 @@ draw(cairo_t *cr, enum cairo_fn op, void *op_args)
         case CLOSE_PATH:
                 cairo_close_path(cr);
                 break;
+        case POLYGON:
+        case POLYLINE: {
+                struct polyline_args *args = op_args;
+
+                draw_points(cr, &args->lod, decimate, args->num_coords / 2,
+                            polyline_point, args);
+                if (op == POLYGON)
+                        cairo_close_path(cr);
+                break;
+        }
+        case POLYLINE_FILE: {
+                struct polyline_file_args *args = op_args;
+                size_t n = args->file->size / (2 * sizeof(double));
+
+                if (args->offset < n)
+                        draw_points(cr, &args->lod, decimate,
+                                    MIN(args->count, n - args->offset),
+                                    polyline_file_point, args);
+                break;
+        }
+        case SERIES: {
+                struct series_args *args = op_args;
+
+                draw_points(cr, &args->lod, decimate, args->count,
+                            series_point, args);
+                break;
+        }
+        case REL_POLYLINE: {
+                struct polyline_args *args = op_args;
+                int i;
+
+                for (i = 0; i < args->num_coords; i += 2)
+                        cairo_rel_line_to(cr, args->coords[i], args->coords[i + 1]);
+                break;
+        }
         case SHOW_TEXT: {
                 struct show_text_args *args = op_args;
 
@@ -1239,19 +2496,339 @@ draw(cairo_t *cr, enum cairo_fn op, void *op_args)
         }
 }
 
+/*
+ * How a drawing operation takes part in the drawing: PAINTS puts
+ * something on the surface; PATH contributes to what the next PAINTS
+ * operations put there; STATE affects all operations following it
+ */
+enum op_kind {
+        PAINTS,
+        PATH,
+        STATE,
+};
+
+static enum op_kind
+op_kind(enum cairo_fn op)
+{
+        switch (op) {
+        case FILL:
+        case FILL_PRESERVE:
+        case SHOW_TEXT:
+        case STROKE:
+        case STROKE_PRESERVE:
+                return PAINTS;
+        case ARC:
+        case ARC_NEGATIVE:
+        case CLOSE_PATH:
+        case CURVE_TO:
+        case LINE_TO:
+        case MOVE_TO:
+        case POLYGON:
+        case POLYLINE:
+        case POLYLINE_FILE:
+        case RECTANGLE:
+        case REL_CURVE_TO:
+        case REL_LINE_TO:
+        case REL_MOVE_TO:
+        case REL_MOVE_FOR:
+        case REL_POLYLINE:
+        case SERIES:
+                return PATH;
+        default:
+                return STATE;
+        }
+}
+
+/*
+ * Store into *r the device space box, widened by a pixel for
+ * antialiasing, around the user space box x1, y1, x2, y2 of cr
+ */
+static void
+device_box(cairo_t *cr, double x1, double y1, double x2, double y2,
+           cairo_rectangle_int_t *r)
+{
+        double x[4] = {x1, x2, x1, x2}, y[4] = {y1, y1, y2, y2};
+        double xmin = INFINITY, ymin = INFINITY;
+        double xmax = -INFINITY, ymax = -INFINITY;
+        int i;
+
+        for (i = 0; i < 4; i++) {
+                cairo_user_to_device(cr, x + i, y + i);
+                xmin = fmin(xmin, x[i]);
+                ymin = fmin(ymin, y[i]);
+                xmax = fmax(xmax, x[i]);
+                ymax = fmax(ymax, y[i]);
+        }
+        r->x = floor(xmin) - 1;
+        r->y = floor(ymin) - 1;
+        r->width = ceil(xmax) + 1 - r->x;
+        r->height = ceil(ymax) + 1 - r->y;
+}
+
+/*
+ * Paint the layers underneath drawing d, rendering into their cached
+ * surfaces those that have none of the right size
+ */
+static void
+draw_layers(GtkWidget *widget, cairo_t *cr, struct drawing *d)
+{
+        cairo_t *lcr;
+        int height = gtk_widget_get_allocated_height(widget);
+        int width = gtk_widget_get_allocated_width(widget);
+        struct draw_op *op;
+        struct drawing *l;
+
+        cairo_save(cr);
+        for (l = d->layers; l != NULL; l = l->next) {
+                if (l->cache != NULL &&
+                    (l->cache_width != width || l->cache_height != height)) {
+                        cairo_surface_destroy(l->cache);
+                        l->cache = NULL;
+                }
+                if (l->cache == NULL) {
+                        l->cache = gdk_window_create_similar_surface(
+                                gtk_widget_get_window(widget),
+                                CAIRO_CONTENT_COLOR_ALPHA, width, height);
+                        l->cache_width = width;
+                        l->cache_height = height;
+                        lcr = cairo_create(l->cache);
+                        for (op = l->first; op != NULL; op = op->next)
+                                draw(lcr, op->op, op->op_args, d->decimate);
+                        cairo_destroy(lcr);
+                }
+                cairo_set_source_surface(cr, l->cache, 0, 0);
+                cairo_paint(cr);
+        }
+        cairo_restore(cr);
+}
+
+/*
+ * Replay drawing d on cr, skipping fills and strokes that are known to
+ * miss clip (in widget coordinates), unless extents may be stale
+ */
+static void
+draw_ops(cairo_t *cr, const struct drawing *d, const cairo_rectangle_int_t *clip)
+{
+        struct draw_op *op;
+
+        for (op = d->first; op != NULL; op = op->next) {
+                if (!d->refresh_pending && !d->changed &&
+                    op->has_extents && !op->dirty &&
+                    op->op != SHOW_TEXT &&
+                    (op->extents.x >= clip->x + clip->width ||
+                     op->extents.y >= clip->y + clip->height ||
+                     op->extents.x + op->extents.width <= clip->x ||
+                     op->extents.y + op->extents.height <= clip->y)) {
+                        if (op->op == FILL || op->op == STROKE)
+                                cairo_new_path(cr);
+                        continue;
+                }
+                draw(cr, op->op, op->op_args, d->decimate);
+        }
+}
+
+/*
+ * A rectangle of a drawing rendered by one of the threads of tile_pool
+ */
+struct tile {
+        cairo_surface_t *surface;
+        cairo_rectangle_int_t rect;
+        const struct drawing *d;
+        struct tile_batch *batch;
+};
+
+/*
+ * Tiles rendered for one call of cb_draw()
+ */
+struct tile_batch {
+        pthread_mutex_t lock;
+        pthread_cond_t done;
+        int pending;
+};
+
+static GThreadPool *tile_pool = NULL;
+
+/*
+ * Render a tile.  Runs inside one of the threads of tile_pool.
+ */
+static void
+render_tile(struct tile *t, void *unused)
+{
+        cairo_t *cr = cairo_create(t->surface);
+
+        (void) unused;
+        draw_ops(cr, t->d, &t->rect);
+        cairo_destroy(cr);
+        pthread_mutex_lock(&t->batch->lock);
+        if (--t->batch->pending == 0)
+                pthread_cond_signal(&t->batch->done);
+        pthread_mutex_unlock(&t->batch->lock);
+}
+
+/*
+ * Have the tiles of drawing d that meet the clip region of cr rendered
+ * in parallel, wait for them, and paint them onto cr.  The tiles'
+ * device offsets make their user space coincide with cr's, so each
+ * pixel comes out as if the whole widget had been rendered at once.
+ */
+static void
+draw_tiles(GtkWidget *widget, cairo_t *cr, const struct drawing *d)
+{
+        cairo_rectangle_list_t *clip = cairo_copy_clip_rectangle_list(cr);
+        cairo_rectangle_int_t r;
+        int height = gtk_widget_get_allocated_height(widget);
+        int width = gtk_widget_get_allocated_width(widget);
+        int scale = gtk_widget_get_scale_factor(widget);
+        int size = d->tile_size, i, n = 0;
+        struct tile *tiles = NULL;
+        struct tile_batch batch;
+
+        for (r.y = 0; r.y < height; r.y += size)
+                for (r.x = 0; r.x < width; r.x += size) {
+                        r.width = MIN(size, width - r.x);
+                        r.height = MIN(size, height - r.y);
+                        for (i = 0; clip->status == CAIRO_STATUS_SUCCESS &&
+                                     i < clip->num_rectangles; i++)
+                                if (clip->rectangles[i].x < r.x + r.width &&
+                                    clip->rectangles[i].y < r.y + r.height &&
+                                    clip->rectangles[i].x + clip->rectangles[i].width > r.x &&
+                                    clip->rectangles[i].y + clip->rectangles[i].height > r.y)
+                                        break;
+                        if (clip->status == CAIRO_STATUS_SUCCESS &&
+                            i == clip->num_rectangles)
+                                continue; /* outside damage region */
+                        if (tiles == NULL &&
+                            (tiles = malloc(((width + size - 1) / size) *
+                                            ((height + size - 1) / size) *
+                                            sizeof(*tiles))) == NULL)
+                                OOM_ABORT;
+                        /* Same device scale, hence same pixels, */
+                        /* as the window */
+                        tiles[n].surface =
+                                gdk_window_create_similar_image_surface(
+                                        gtk_widget_get_window(widget),
+                                        CAIRO_FORMAT_ARGB32,
+                                        r.width, r.height, scale);
+                        cairo_surface_set_device_offset(tiles[n].surface,
+                                                        -r.x * scale,
+                                                        -r.y * scale);
+                        tiles[n].rect = r;
+                        tiles[n].d = d;
+                        tiles[n].batch = &batch;
+                        n++;
+                }
+        if (n == 0) {
+                cairo_rectangle_list_destroy(clip);
+                return;
+        }
+        if (tile_pool == NULL)
+                tile_pool = g_thread_pool_new((GFunc) render_tile, NULL,
+                                              g_get_num_processors(),
+                                              FALSE, NULL);
+        pthread_mutex_init(&batch.lock, NULL);
+        pthread_cond_init(&batch.done, NULL);
+        batch.pending = n;
+        for (i = 0; i < n; i++)
+                g_thread_pool_push(tile_pool, tiles + i, NULL);
+        pthread_mutex_lock(&batch.lock);
+        while (batch.pending > 0)
+                pthread_cond_wait(&batch.done, &batch.lock);
+        pthread_mutex_unlock(&batch.lock);
+        for (i = 0; i < n; i++) {
+                cairo_surface_set_device_offset(tiles[i].surface, 0, 0);
+                cairo_set_source_surface(cr, tiles[i].surface,
+                                         tiles[i].rect.x, tiles[i].rect.y);
+                cairo_rectangle(cr, tiles[i].rect.x, tiles[i].rect.y,
+                                tiles[i].rect.width, tiles[i].rect.height);
+                cairo_fill(cr);
+                cairo_surface_destroy(tiles[i].surface);
+        }
+        pthread_cond_destroy(&batch.done);
+        pthread_mutex_destroy(&batch.lock);
+        cairo_rectangle_list_destroy(clip);
+        free(tiles);
+}
+
+/*
+ * Note that something in layer d has changed
+ */
+static void
+touch_drawing(struct drawing *d)
+{
+        d->changed = true;
+        if (d->cache != NULL) {
+                cairo_surface_destroy(d->cache);
+                d->cache = NULL;
+        }
+}
+
+/*
+ * Have the polyline_file operations of drawing d and its layers whose
+ * files have changed since d last looked redrawn in full.  Return
+ * true if there were any.
+ */
+static bool
+catch_up_vertex_files(struct drawing *d)
+{
+        bool changed = false;
+        struct drawing *l;
+        struct draw_op *op;
+        struct polyline_file_args *args;
+
+        if (d->files_version == vertex_files_version)
+                return false;
+        for (l = d; l != NULL; l = l == d ? d->layers : l->next)
+                for (op = l->first; op != NULL; op = op->next) {
+                        if (op->op != POLYLINE_FILE)
+                                continue;
+                        args = op->op_args;
+                        if (args->version == args->file->version)
+                                continue;
+                        args->version = args->file->version;
+                        free_lod(&args->lod);
+                        op->dirty = true;
+                        touch_drawing(l);
+                        changed = true;
+                }
+        d->files_version = vertex_files_version;
+        return changed;
+}
+
 /*
  * Callback that draws on a GtkDrawingArea
  */
 static gboolean
 cb_draw(GtkWidget *widget, cairo_t *cr, gpointer data)
 {
-        struct draw_op *op;
+        cairo_rectangle_int_t clip;
+        double x1, y1, x2, y2;
+        struct drawing *d;
 
         (void) data;
-        for (op = g_object_get_data(G_OBJECT(widget), "draw_ops");
-             op != NULL;
-             op = op->next)
-                draw(cr, op->op, op->op_args);
+        if ((d = g_object_get_data(G_OBJECT(widget), "drawing")) == NULL)
+                return FALSE;
+        sync_vertex_files();
+        /* Parts outside the clip may have changed, too */
+        if (catch_up_vertex_files(d))
+                gtk_widget_queue_draw(widget);
+        if (d->canvas != NULL) {
+                cairo_save(cr);
+                cairo_set_source_surface(cr, d->canvas, 0, 0);
+                cairo_paint(cr);
+                cairo_restore(cr);
+        }
+        draw_layers(widget, cr, d);
+        if (d->tile_size > 0) {
+                draw_tiles(widget, cr, d);
+                return FALSE;
+        }
+        /* still in widget coordinates, like the extents of d's ops */
+        cairo_clip_extents(cr, &x1, &y1, &x2, &y2);
+        clip.x = floor(x1) - 1;
+        clip.y = floor(y1) - 1;
+        clip.width = ceil(x2) + 1 - clip.x;
+        clip.height = ceil(y2) + 1 - clip.y;
+        draw_ops(cr, d, &clip);
         return FALSE;
 }
 
@@ -1307,6 +2884,22 @@ update_focus(struct ui_data *ud){
                 ign_cmd(ud->type, ud->cmd);
 }
 
+/*
+ * With option -s, have the next feedback message, which should be the
+ * reply to command ud, sent only to the client ud came from.  Runs
+ * inside gtk_main().
+ */
+static void
+route_reply(struct ui_data *ud)
+{
+        char str[BUFLEN];
+
+        if (ud->client == 0)
+                return;
+        snprintf(str, BUFLEN, "\001%llu", ud->client);
+        send_msg_by_id(ud->args->fout, str, "", NULL);
+}
+
 /*
  * Have the widget say "ping".  Runs inside gtk_main().
  */
@@ -1315,6 +2908,7 @@ ping(struct ui_data *ud)
 {
         if (!GTK_IS_WIDGET(ud->obj))
                 ign_cmd(ud->type, ud->cmd);
+        route_reply(ud);
         ud->args->txt = "ping";
         ud->args->data = ud->data;
         cb_simple(GTK_BUILDABLE(ud->obj), ud->args);
@@ -1437,7 +3031,8 @@ update_visibility(struct ui_data *ud)
 }
 
 /*
- * Change the style of the widget passed.  Runs inside gtk_main().
+ * Change the style of the widget passed, giving it a style provider of
+ * its own the first time.  Runs inside gtk_main().
  */
 static void
 update_widget_style(struct ui_data *ud)
@@ -1452,10 +3047,13 @@ update_widget_style(struct ui_data *ud)
                 ign_cmd(ud->type, ud->cmd);
                 return;
         }
-        style_provider = g_object_get_data(ud->obj, "style_provider");
         sz = strlen(prefix) + strlen(suffix) + strlen(ud->data) + 1;
         context = gtk_widget_get_style_context(GTK_WIDGET(ud->obj));
-        gtk_style_context_remove_provider(context, style_provider);
+        if ((style_provider = g_object_get_data(ud->obj, "style_provider")) == NULL) {
+                style_provider = GTK_STYLE_PROVIDER(gtk_css_provider_new());
+                g_object_set_data(ud->obj, "style_provider", style_provider);
+        } else
+                gtk_style_context_remove_provider(context, style_provider);
         if ((style_decl = malloc(sz)) == NULL)
                 OOM_ABORT;
         strcpy(style_decl, prefix);
@@ -1469,48 +3067,83 @@ update_widget_style(struct ui_data *ud)
 }
 
 /*
- * Check if one of the generic actions is requested; complain if none
- * of them is
+ * Add a style class to, or remove one from, the widget passed.  Runs
+ * inside gtk_main().
  */
 static void
-try_generic_cmds(struct ui_data *ud)
+update_style_class(struct ui_data *ud)
 {
-        if (eql(ud->action, "block"))
-                update_blocked(ud);
-        else if (eql(ud->action, "set_sensitive"))
-                update_sensitivity(ud);
-        else if (eql(ud->action, "set_visible"))
-                update_visibility(ud);
-        else if (eql(ud->action, "set_tooltip_text"))
-                update_tooltip_text(ud);
-        else if (eql(ud->action, "grab_focus"))
-                update_focus(ud);
-        else if (eql(ud->action, "set_size_request"))
-                update_size_request(ud);
-        else if (eql(ud->action, "style"))
-                update_widget_style(ud);
-        else if (eql(ud->action, "force"))
-                fake_ui_activity(ud);
-        else if (eql(ud->action, "ping"))
-                ping(ud);
-        else if (eql(ud->action, "snapshot"))
-                take_snapshot(ud);
-        else
+        GtkStyleContext *context;
+        char dummy, *name;
+
+        if (!GTK_IS_WIDGET(ud->obj)) {
+                ign_cmd(ud->type, ud->cmd);
+                return;
+        }
+        if ((name = malloc(strlen(ud->data) + 1)) == NULL)
+                OOM_ABORT;
+        if (sscanf(ud->data, "%s %c", name, &dummy) != 1)
                 ign_cmd(ud->type, ud->cmd);
+        else {
+                context = gtk_widget_get_style_context(GTK_WIDGET(ud->obj));
+                if (ud->act == ACT_ADD_CLASS)
+                        gtk_style_context_add_class(context, name);
+                else
+                        gtk_style_context_remove_class(context, name);
+        }
+        free(name);
 }
 
 /*
- * Manipulation of specific widgets
+ * Load the shared stylesheet anew.  Runs inside gtk_main().
  */
-
 static void
-update_button(struct ui_data *ud)
+update_stylesheet(struct ui_data *ud)
 {
-        if (eql(ud->action, "set_label"))
-                gtk_button_set_label(GTK_BUTTON(ud->obj), ud->data);
-        else
-                try_generic_cmds(ud);
-}
+        GError *error = NULL;
+
+        if (!load_stylesheet(ud->data, &error)) {
+                ign_cmd(ud->type, ud->cmd);
+                g_error_free(error);
+        }
+}
+
+/*
+ * Check if one of the generic actions is requested; complain if none
+ * of them is
+ */
+static void
+try_generic_cmds(struct ui_data *ud)
+{
+        switch (ud->act) {
+        case ACT_BLOCK: update_blocked(ud); break;
+        case ACT_SET_SENSITIVE: update_sensitivity(ud); break;
+        case ACT_SET_VISIBLE: update_visibility(ud); break;
+        case ACT_SET_TOOLTIP_TEXT: update_tooltip_text(ud); break;
+        case ACT_GRAB_FOCUS: update_focus(ud); break;
+        case ACT_SET_SIZE_REQUEST: update_size_request(ud); break;
+        case ACT_STYLE: update_widget_style(ud); break;
+        case ACT_ADD_CLASS:
+        case ACT_REMOVE_CLASS: update_style_class(ud); break;
+        case ACT_FORCE: fake_ui_activity(ud); break;
+        case ACT_PING: ping(ud); break;
+        case ACT_SNAPSHOT: take_snapshot(ud); break;
+        default: ign_cmd(ud->type, ud->cmd); break;
+        }
+}
+
+/*
+ * Manipulation of specific widgets
+ */
+
+static void
+update_button(struct ui_data *ud)
+{
+        if (ud->act == ACT_SET_LABEL)
+                gtk_button_set_label(GTK_BUTTON(ud->obj), ud->data);
+        else
+                try_generic_cmds(ud);
+}
 
 static void
 update_calendar(struct ui_data *ud)
@@ -1519,20 +3152,20 @@ update_calendar(struct ui_data *ud)
         char dummy;
         int year = 0, month = 0, day = 0;
 
-        if (eql(ud->action, "select_date") &&
+        if (ud->act == ACT_SELECT_DATE &&
             sscanf(ud->data, "%d-%d-%d %c", &year, &month, &day, &dummy) == 3) {
                 if (month > -1 && month <= 11 && day > 0 && day <= 31) {
                         gtk_calendar_select_month(calendar, --month, year);
                         gtk_calendar_select_day(calendar, day);
                 } else
                         ign_cmd(ud->type, ud->cmd);
-        } else if (eql(ud->action, "mark_day") &&
+        } else if (ud->act == ACT_MARK_DAY &&
                    sscanf(ud->data, "%d %c", &day, &dummy) == 1) {
                 if (day > 0 && day <= 31)
                         gtk_calendar_mark_day(calendar, day);
                 else
                         ign_cmd(ud->type, ud->cmd);
-        } else if (eql(ud->action, "clear_marks") && sscanf(ud->data, " %c", &dummy) < 1)
+        } else if (ud->act == ACT_CLEAR_MARKS && sscanf(ud->data, " %c", &dummy) < 1)
                 gtk_calendar_clear_marks(calendar);
         else
                 try_generic_cmds(ud);
@@ -1549,19 +3182,19 @@ update_class_window(struct ui_data *ud)
         char dummy;
         int x, y;
 
-        if (eql(ud->action, "set_title"))
+        if (ud->act == ACT_SET_TITLE)
                 gtk_window_set_title(window, ud->data);
-        else if (eql(ud->action, "fullscreen") && sscanf(ud->data, " %c", &dummy) < 1)
+        else if (ud->act == ACT_FULLSCREEN && sscanf(ud->data, " %c", &dummy) < 1)
                 gtk_window_fullscreen(window);
-        else if (eql(ud->action, "unfullscreen") && sscanf(ud->data, " %c", &dummy) < 1)
+        else if (ud->act == ACT_UNFULLSCREEN && sscanf(ud->data, " %c", &dummy) < 1)
                 gtk_window_unfullscreen(window);
-        else if (eql(ud->action, "resize") &&
+        else if (ud->act == ACT_RESIZE &&
                  sscanf(ud->data, "%d %d %c", &x, &y, &dummy) == 2)
                 gtk_window_resize(window, x, y);
-        else if (eql(ud->action, "resize") && sscanf(ud->data, " %c", &dummy) < 1) {
+        else if (ud->act == ACT_RESIZE && sscanf(ud->data, " %c", &dummy) < 1) {
                 gtk_window_get_default_size(window, &x, &y);
                 gtk_window_resize(window, x, y);
-        } else if (eql(ud->action, "move") &&
+        } else if (ud->act == ACT_MOVE &&
                    sscanf(ud->data, "%d %d %c", &x, &y, &dummy) == 2)
                 gtk_window_move(window, x, y);
         else
@@ -1574,7 +3207,7 @@ update_color_button(struct ui_data *ud)
 {
         GdkRGBA color;
 
-        if (eql(ud->action, "set_color")) {
+        if (ud->act == ACT_SET_COLOR) {
                 gdk_rgba_parse(&color, ud->data);
                 gtk_color_chooser_set_rgba(GTK_COLOR_CHOOSER(ud->obj), &color);
         } else
@@ -1588,14 +3221,14 @@ update_combo_box_text(struct ui_data *ud)
         char dummy;
         int txt0, pos;
 
-        if (eql(ud->action, "prepend_text"))
+        if (ud->act == ACT_PREPEND_TEXT)
                 gtk_combo_box_text_prepend_text(combobox, ud->data);
-        else if (eql(ud->action, "append_text"))
+        else if (ud->act == ACT_APPEND_TEXT)
                 gtk_combo_box_text_append_text(combobox, ud->data);
-        else if (eql(ud->action, "remove") &&
+        else if (ud->act == ACT_REMOVE &&
                  sscanf(ud->data, "%d %c", &pos, &dummy) == 1)
                 gtk_combo_box_text_remove(combobox, pos);
-        else if (eql(ud->action, "insert_text") &&
+        else if (ud->act == ACT_INSERT_TEXT &&
                  sscanf(ud->data, "%d %n", &pos, &txt0) == 1)
                 gtk_combo_box_text_insert_text(combobox, pos, ud->data + txt0);
         else
@@ -1615,14 +3248,145 @@ enum draw_op_stat {
 };
 
 /*
- * Fill structure *op with the drawing operation according to action
- * and with the appropriate set of arguments
+ * Drawing operations and their arguments are kept in blocks of a few
+ * sizes which are carved one after another out of large slabs, so an
+ * operation's arguments usually follow right behind it.  Freed blocks
+ * are kept for the next request of their size; replacing an operation
+ * by one of the same kind thus reuses its memory.  Anything larger
+ * than the largest size is malloc()ed individually.
+ */
+#define POOL_CLASSES 5          /* payloads of 32, 64, ..., 512 bytes */
+#define POOL_SLAB 65536
+
+union pool_block {
+        int class;              /* or -1 if malloc()ed individually */
+        union pool_block *next; /* while on a free list */
+        double align_d;
+        long long align_ll;
+        void *align_p;
+};
+
+static union pool_block *pool_free_list[POOL_CLASSES];
+static char *pool_slab = NULL;
+static size_t pool_slab_left = 0;
+
+static void *
+op_alloc(size_t size)
+{
+        int c;
+        size_t len;
+        union pool_block *b;
+
+        for (c = 0; c < POOL_CLASSES && size > (size_t) 32 << c; c++)
+                ;
+        if (c == POOL_CLASSES) {
+                if ((b = malloc(sizeof(*b) + size)) == NULL)
+                        return NULL;
+                b->class = -1;
+                return b + 1;
+        }
+        if ((b = pool_free_list[c]) != NULL)
+                pool_free_list[c] = b->next;
+        else {
+                len = sizeof(*b) + ((size_t) 32 << c);
+                if (pool_slab_left < len) {
+                        if ((pool_slab = malloc(POOL_SLAB)) == NULL)
+                                return NULL;
+                        pool_slab_left = POOL_SLAB;
+                }
+                b = (union pool_block *) pool_slab;
+                pool_slab += len;
+                pool_slab_left -= len;
+        }
+        b->class = c;
+        return b + 1;
+}
+
+static void
+op_free(void *p)
+{
+        int c;
+        union pool_block *b;
+
+        if (p == NULL)
+                return;
+        b = (union pool_block *) p - 1;
+        if ((c = b->class) < 0) {
+                free(b);
+                return;
+        }
+        b->next = pool_free_list[c];
+        pool_free_list[c] = b;
+}
+
+/*
+ * Free the arguments of drawing operation op, along with anything
+ * they hold on to
+ */
+static void
+free_op_args(struct draw_op *op)
+{
+        if (op->op_args == NULL)
+                return;
+        switch (op->op) {
+        case POLYGON:
+        case POLYLINE:
+                free_lod(&((struct polyline_args *) op->op_args)->lod);
+                break;
+        case POLYLINE_FILE:
+                free_lod(&((struct polyline_file_args *) op->op_args)->lod);
+                release_vertex_file(((struct polyline_file_args *) op->op_args)->file);
+                break;
+        case SERIES:
+                free_lod(&((struct series_args *) op->op_args)->lod);
+                break;
+        default:
+                break;
+        }
+        op_free(op->op_args);
+}
+
+/*
+ * Store n numbers into the double * arguments following n.  Take them
+ * from the binary arguments of ud if it has any, in which case txt
+ * must be blank; otherwise, parse them from txt.  Return true if
+ * there were exactly n numbers.
+ */
+static bool
+scan_doubles(const struct ui_data *ud, const char *txt, size_t n, ...)
+{
+        char dummy, *end;
+        bool ok = true;
+        size_t i;
+        va_list ap;
+
+        va_start(ap, n);
+        if (ud->bin != NULL) {
+                ok = ud->bin_len == n * sizeof(double) &&
+                        sscanf(txt, " %c", &dummy) < 1;
+                for (i = 0; ok && i < n; i++)
+                        memcpy(va_arg(ap, double *),
+                               ud->bin + i * sizeof(double), sizeof(double));
+        } else {
+                for (i = 0; ok && i < n; i++, txt = end) {
+                        *va_arg(ap, double *) = strtod(txt, &end);
+                        ok = end != txt;
+                }
+                ok = ok && sscanf(txt, " %c", &dummy) < 1;
+        }
+        va_end(ap);
+        return ok;
+}
+
+/*
+ * Fill structure *op with the drawing operation requested by ud and
+ * with the appropriate set of arguments
  */
 static enum draw_op_stat
-set_draw_op(struct draw_op *op, const char *action, const char *data)
+set_draw_op(struct draw_op *op, const struct ui_data *ud)
 {
         char dummy;
-        const char *raw_args = data;
+        const char *data = ud->data, *raw_args = ud->data;
         enum draw_op_stat result = SUCCESS;
         int args_start = 0;
 
@@ -1637,116 +3401,138 @@ set_draw_op(struct draw_op *op, const char *action, const char *data)
         else
                 return FAILURE;
         raw_args += args_start;
-        if (eql(action, "line_to")) {
+        switch (ud->act) {
+        case ACT_LINE_TO: {
                 struct move_to_args *args;
 
-                if ((args = malloc(sizeof(*args))) == NULL)
+                if ((args = op_alloc(sizeof(*args))) == NULL)
                         OOM_ABORT;
                 op->op = LINE_TO;
                 op->op_args = args;
-                if (sscanf(raw_args, "%lf %lf %c", &args->x, &args->y, &dummy) != 2)
+                if (!scan_doubles(ud, raw_args, 2, &args->x, &args->y))
                         return FAILURE;
-        } else if (eql(action, "rel_line_to")) {
+                break;
+        }
+        case ACT_REL_LINE_TO: {
                 struct move_to_args *args;
 
-                if ((args = malloc(sizeof(*args))) == NULL)
+                if ((args = op_alloc(sizeof(*args))) == NULL)
                         OOM_ABORT;
                 op->op = REL_LINE_TO;
                 op->op_args = args;
-                if (sscanf(raw_args, "%lf %lf %c", &args->x, &args->y, &dummy) != 2)
+                if (!scan_doubles(ud, raw_args, 2, &args->x, &args->y))
                         return FAILURE;
-        } else if (eql(action, "move_to")) {
+                break;
+        }
+        case ACT_MOVE_TO: {
                 struct move_to_args *args;
 
-                if ((args = malloc(sizeof(*args))) == NULL)
+                if ((args = op_alloc(sizeof(*args))) == NULL)
                         OOM_ABORT;
                 op->op = MOVE_TO;
                 op->op_args = args;
-                if (sscanf(raw_args, "%lf %lf %c", &args->x, &args->y, &dummy) != 2)
+                if (!scan_doubles(ud, raw_args, 2, &args->x, &args->y))
                         return FAILURE;
-        } else if (eql(action, "rel_move_to")) {
+                break;
+        }
+        case ACT_REL_MOVE_TO: {
                 struct move_to_args *args;
 
-                if ((args = malloc(sizeof(*args))) == NULL)
+                if ((args = op_alloc(sizeof(*args))) == NULL)
                         OOM_ABORT;
                 op->op = REL_MOVE_TO;
                 op->op_args = args;
-                if (sscanf(raw_args, "%lf %lf %c", &args->x, &args->y, &dummy) != 2)
+                if (!scan_doubles(ud, raw_args, 2, &args->x, &args->y))
                         return FAILURE;
-        } else if (eql(action, "arc")) {
+                break;
+        }
+        case ACT_ARC: {
                 struct arc_args *args;
                 double deg1, deg2;
 
-                if ((args = malloc(sizeof(*args))) == NULL)
+                if ((args = op_alloc(sizeof(*args))) == NULL)
                         OOM_ABORT;
                 op->op = ARC;
                 op->op_args = args;
-                if (sscanf(raw_args, "%lf %lf %lf %lf %lf %c",
-                           &args->x, &args->y, &args->radius, &deg1, &deg2, &dummy) != 5)
+                if (!scan_doubles(ud, raw_args, 5,
+                                  &args->x, &args->y, &args->radius, &deg1, &deg2))
                         return FAILURE;
                 args->angle1 = deg1 * (M_PI / 180.L);
                 args->angle2 = deg2 * (M_PI / 180.L);
-        } else if (eql(action, "arc_negative")) {
+                break;
+        }
+        case ACT_ARC_NEGATIVE: {
                 double deg1, deg2;
                 struct arc_args *args;
 
-                if ((args = malloc(sizeof(*args))) == NULL)
+                if ((args = op_alloc(sizeof(*args))) == NULL)
                         OOM_ABORT;
                 op->op = ARC_NEGATIVE;
                 op->op_args = args;
-                if (sscanf(raw_args, "%lf %lf %lf %lf %lf %c",
-                           &args->x, &args->y, &args->radius, &deg1, &deg2, &dummy) != 5)
+                if (!scan_doubles(ud, raw_args, 5,
+                                  &args->x, &args->y, &args->radius, &deg1, &deg2))
                         return FAILURE;
                 args->angle1 = deg1 * (M_PI / 180.L);
                 args->angle2 = deg2 * (M_PI / 180.L);
-        } else if (eql(action, "curve_to")) {
+                break;
+        }
+        case ACT_CURVE_TO: {
                 struct curve_to_args *args;
 
-                if ((args = malloc(sizeof(*args))) == NULL)
+                if ((args = op_alloc(sizeof(*args))) == NULL)
                         OOM_ABORT;
                 op->op = CURVE_TO;
                 op->op_args = args;
-                if (sscanf(raw_args, "%lf %lf %lf %lf %lf %lf %c",
-                           &args->x1, &args->y1, &args->x2, &args->y2, &args->x3, &args->y3, &dummy) != 6)
+                if (!scan_doubles(ud, raw_args, 6,
+                                  &args->x1, &args->y1, &args->x2, &args->y2, &args->x3, &args->y3))
                         return FAILURE;
-        } else if (eql(action, "rel_curve_to")) {
+                break;
+        }
+        case ACT_REL_CURVE_TO: {
                 struct curve_to_args *args;
 
-                if ((args = malloc(sizeof(*args))) == NULL)
+                if ((args = op_alloc(sizeof(*args))) == NULL)
                         OOM_ABORT;
                 op->op = REL_CURVE_TO;
                 op->op_args = args;
-                if (sscanf(raw_args, "%lf %lf %lf %lf %lf %lf %c",
-                           &args->x1, &args->y1, &args->x2, &args->y2, &args->x3, &args->y3, &dummy) != 6)
+                if (!scan_doubles(ud, raw_args, 6,
+                                  &args->x1, &args->y1, &args->x2, &args->y2, &args->x3, &args->y3))
                         return FAILURE;
-        } else if (eql(action, "rectangle")) {
+                break;
+        }
+        case ACT_RECTANGLE: {
                 struct rectangle_args *args;
 
-                if ((args = malloc(sizeof(*args))) == NULL)
+                if ((args = op_alloc(sizeof(*args))) == NULL)
                         OOM_ABORT;
                 op->op = RECTANGLE;
                 op->op_args = args;
-                if (sscanf(raw_args, "%lf %lf %lf %lf %c",
-                           &args->x, &args->y, &args->width, &args->height, &dummy) != 4)
+                if (!scan_doubles(ud, raw_args, 4,
+                                  &args->x, &args->y, &args->width, &args->height))
                         return FAILURE;
-        } else if (eql(action, "close_path")) {
+                break;
+        }
+        case ACT_CLOSE_PATH:
                 op->op = CLOSE_PATH;
                 if (sscanf(raw_args, " %c", &dummy) > 0)
                         return FAILURE;
                 op->op_args = NULL;
-        } else if (eql(action, "show_text")) {
+                break;
+        case ACT_SHOW_TEXT: {
                 struct show_text_args *args;
                 int len;
 
                 len = strlen(raw_args) + 1;
-                if ((args = malloc(sizeof(*args) + len * sizeof(args->text[0]))) == NULL)
+                if ((args = op_alloc(sizeof(*args) + len * sizeof(args->text[0]))) == NULL)
                         OOM_ABORT;
                 op->op = SHOW_TEXT;
                 op->op_args = args;
                 args->len = len; /* not used */
                 strncpy(args->text, raw_args, len);
                 result = NEED_REDRAW;
-        } else if (eql(action, "rel_move_for")) {
+                break;
+        }
+        case ACT_REL_MOVE_FOR: {
                 char ref_point[2 + 1];
                 int start, len;
                 struct rel_move_for_args *args;
@@ -1754,7 +3540,7 @@ set_draw_op(struct draw_op *op, const char *action, const char *data)
                 if (sscanf(raw_args, "%2s %n", ref_point, &start) < 1)
                         return FAILURE;
                 len = strlen(raw_args + start) + 1;
-                if ((args = malloc(sizeof(*args) + len * sizeof(args->text[0]))) == NULL)
+                if ((args = op_alloc(sizeof(*args) + len * sizeof(args->text[0]))) == NULL)
                         OOM_ABORT;
                 if (eql(ref_point, "c"))
                         args->ref = C;
@@ -1780,31 +3566,37 @@ set_draw_op(struct draw_op *op, const char *action, const char *data)
                 op->op_args = args;
                 args->len = len; /* not used */
                 strncpy(args->text, (raw_args + start), len);
-        } else if (eql(action, "stroke")) {
+                break;
+        }
+        case ACT_STROKE:
                 op->op = STROKE;
                 if (sscanf(raw_args, " %c", &dummy) > 0)
                         return FAILURE;
                 op->op_args = NULL;
                 result = NEED_REDRAW;
-        } else if (eql(action, "stroke_preserve")) {
+                break;
+        case ACT_STROKE_PRESERVE:
                 op->op = STROKE_PRESERVE;
                 if (sscanf(raw_args, " %c", &dummy) > 0)
                         return FAILURE;
                 op->op_args = NULL;
                 result = NEED_REDRAW;
-        } else if (eql(action, "fill")) {
+                break;
+        case ACT_FILL:
                 op->op = FILL;
                 if (sscanf(raw_args, " %c", &dummy) > 0)
                         return FAILURE;
                 op->op_args = NULL;
                 result = NEED_REDRAW;
-        } else if (eql(action, "fill_preserve")) {
+                break;
+        case ACT_FILL_PRESERVE:
                 op->op = FILL_PRESERVE;
                 if (sscanf(raw_args, " %c", &dummy) > 0)
                         return FAILURE;
                 op->op_args = NULL;
                 result = NEED_REDRAW;
-        } else if (eql(action, "set_dash")) {
+                break;
+        case ACT_SET_DASH: {
                 char *next, *end;
                 char data1[strlen(raw_args) + 1];
                 int n, i;
@@ -1818,15 +3610,109 @@ set_draw_op(struct draw_op *op, const char *action, const char *data)
                         next = end;
                         strtod(next, &end);
                 } while (next != end);
-                if ((args = malloc(sizeof(*args) + n * sizeof(args->dashes[0]))) == NULL)
+                if (ud->bin != NULL) {
+                        if (n > 0 || ud->bin_len % sizeof(double) != 0)
+                                return FAILURE;
+                        n = ud->bin_len / sizeof(double);
+                }
+                if ((args = op_alloc(sizeof(*args) + n * sizeof(args->dashes[0]))) == NULL)
                         OOM_ABORT;
                 op->op = SET_DASH;
                 op->op_args = args;
                 args->num_dashes = n;
-                for (i = 0, next = data1; i < n; i++, next = end) {
-                        args->dashes[i] = strtod(next, &end);
+                if (ud->bin != NULL)
+                        memcpy(args->dashes, ud->bin, ud->bin_len);
+                else
+                        for (i = 0, next = data1; i < n; i++, next = end)
+                                args->dashes[i] = strtod(next, &end);
+                break;
+        }
+        case ACT_POLYLINE_FILE: {
+                int path_start = 0;
+                size_t offset, count;
+                struct polyline_file_args *args;
+                struct vertex_file *vf;
+
+                if (ud->bin != NULL ||
+                    sscanf(raw_args, "%zu %zu %n", &offset, &count, &path_start) != 2 ||
+                    raw_args[path_start] == '\0' ||
+                    (vf = get_vertex_file(raw_args + path_start)) == NULL)
+                        return FAILURE;
+                if ((args = op_alloc(sizeof(*args))) == NULL)
+                        OOM_ABORT;
+                op->op = POLYLINE_FILE;
+                op->op_args = args;
+                args->lod = NULL;
+                args->file = vf;
+                args->version = vf->version;
+                args->offset = offset;
+                args->count = count;
+                break;
+        }
+        case ACT_SERIES: {
+                int capacity, start = 0;
+                struct series_args *args;
+
+                if (sscanf(raw_args, "%d %n", &capacity, &start) != 1 ||
+                    capacity < 2 || capacity > MAX_SERIES_LEN)
+                        return FAILURE;
+                if ((args = op_alloc(sizeof(*args) + capacity * sizeof(args->samples[0]))) == NULL)
+                        OOM_ABORT;
+                op->op = SERIES;
+                op->op_args = args;
+                args->lod = NULL;
+                args->capacity = capacity;
+                args->count = 0;
+                args->head = 0;
+                if (!scan_doubles(ud, raw_args + start, 6,
+                                  &args->x, &args->y, &args->width, &args->height,
+                                  &args->ymin, &args->ymax) ||
+                    args->ymin == args->ymax)
+                        return FAILURE;
+                break;
+        }
+        case ACT_POLYGON:
+        case ACT_POLYLINE:
+        case ACT_REL_POLYLINE: {
+                const char *next;
+                char *end;
+                int n, i;
+                struct polyline_args *args;
+
+                for (n = 0, next = raw_args;; n++, next = end) {
+                        strtod(next, &end);
+                        if (end == next)
+                                break;
+                }
+                if (sscanf(next, " %c", &dummy) > 0)
+                        return FAILURE;
+                if (ud->bin != NULL) {
+                        if (n > 0)
+                                return FAILURE;
+                        n = ud->bin_len / sizeof(double);
                 }
-        } else if (eql(action, "set_font_face")) {
+                if (n == 0 || n % 2 != 0 ||
+                    (ud->bin != NULL && ud->bin_len != n * sizeof(double)))
+                        return FAILURE;
+                if ((args = op_alloc(sizeof(*args) + n * sizeof(args->coords[0]))) == NULL)
+                        OOM_ABORT;
+                if (ud->act == ACT_POLYGON)
+                        op->op = POLYGON;
+                else if (ud->act == ACT_POLYLINE)
+                        op->op = POLYLINE;
+                else
+                        op->op = REL_POLYLINE;
+                op->op_args = args;
+                args->lod = NULL;
+                args->num_coords = n;
+                if (ud->bin != NULL)
+                        memcpy(args->coords, ud->bin, ud->bin_len);
+                else
+                        for (i = 0, next = raw_args; i < n; i++, next = end)
+                                args->coords[i] = strtod(next, &end);
+                break;
+        }
+        case ACT_SET_FONT_FACE: {
                 char slant[7 + 1];  /* "oblique" */
                 char weight[6 + 1]; /* "normal" */
                 int family_start, family_len;
@@ -1835,7 +3721,7 @@ set_draw_op(struct draw_op *op, const char *action, const char *data)
                 if (sscanf(raw_args, "%7s %6s %n%*s", slant, weight, &family_start) != 2)
                         return FAILURE;
                 family_len = strlen(raw_args + family_start) + 1;
-                if ((args = malloc(sizeof(*args) + family_len * sizeof(args->family[0]))) == NULL)
+                if ((args = op_alloc(sizeof(*args) + family_len * sizeof(args->family[0]))) == NULL)
                         OOM_ABORT;
                 op->op = SET_FONT_FACE;
                 op->op_args = args;
@@ -1854,20 +3740,24 @@ set_draw_op(struct draw_op *op, const char *action, const char *data)
                         args->weight = CAIRO_FONT_WEIGHT_BOLD;
                 else
                         return FAILURE;
-        } else if (eql(action, "set_font_size")) {
+                break;
+        }
+        case ACT_SET_FONT_SIZE: {
                 struct set_font_size_args *args;
 
-                if ((args = malloc(sizeof(*args))) == NULL)
+                if ((args = op_alloc(sizeof(*args))) == NULL)
                         OOM_ABORT;
                 op->op = SET_FONT_SIZE;
                 op->op_args = args;
-                if (sscanf(raw_args, "%lf %c", &args->size, &dummy) != 1)
+                if (!scan_doubles(ud, raw_args, 1, &args->size))
                         return FAILURE;
-        } else if (eql(action, "set_line_cap")) {
+                break;
+        }
+        case ACT_SET_LINE_CAP: {
                 char str[6 + 1]; /* "square" */
                 struct set_line_cap_args *args;
 
-                if ((args = malloc(sizeof(*args))) == NULL)
+                if ((args = op_alloc(sizeof(*args))) == NULL)
                         OOM_ABORT;
                 op->op = SET_LINE_CAP;
                 op->op_args = args;
@@ -1881,11 +3771,13 @@ set_draw_op(struct draw_op *op, const char *action, const char *data)
                         args->line_cap = CAIRO_LINE_CAP_SQUARE;
                 else
                         return FAILURE;
-        } else if (eql(action, "set_line_join")) {
+                break;
+        }
+        case ACT_SET_LINE_JOIN: {
                 char str[5 + 1]; /* "miter" */
                 struct set_line_join_args *args;
 
-                if ((args = malloc(sizeof(*args))) == NULL)
+                if ((args = op_alloc(sizeof(*args))) == NULL)
                         OOM_ABORT;
                 op->op = SET_LINE_JOIN;
                 op->op_args = args;
@@ -1899,247 +3791,729 @@ set_draw_op(struct draw_op *op, const char *action, const char *data)
                         args->line_join = CAIRO_LINE_JOIN_BEVEL;
                 else
                         return FAILURE;
-        } else if (eql(action, "set_line_width")) {
+                break;
+        }
+        case ACT_SET_LINE_WIDTH: {
                 struct set_line_width_args *args;
 
-                if ((args = malloc(sizeof(*args))) == NULL)
+                if ((args = op_alloc(sizeof(*args))) == NULL)
                         OOM_ABORT;
                 op->op = SET_LINE_WIDTH;
                 op->op_args = args;
-                if (sscanf(raw_args, "%lf %c", &args->width, &dummy) != 1)
+                if (!scan_doubles(ud, raw_args, 1, &args->width))
                         return FAILURE;
-        } else if (eql(action, "set_source_rgba")) {
+                break;
+        }
+        case ACT_SET_SOURCE_RGBA: {
                 struct set_source_rgba_args *args;
 
-                if ((args = malloc(sizeof(*args))) == NULL)
+                if ((args = op_alloc(sizeof(*args))) == NULL)
                         OOM_ABORT;
                 op->op = SET_SOURCE_RGBA;
                 op->op_args = args;
                 gdk_rgba_parse(&args->color, raw_args);
-        } else if (eql(action, "transform")) {
+                break;
+        }
+        case ACT_TRANSFORM: {
                 char dummy;
                 double xx, yx, xy, yy, x0, y0;
 
-                if (sscanf(raw_args, "%lf %lf %lf %lf %lf %lf %c",
-                           &xx, &yx, &xy, &yy, &x0, &y0, &dummy) == 6) {
+                if (scan_doubles(ud, raw_args, 6, &xx, &yx, &xy, &yy, &x0, &y0)) {
                         struct transform_args *args;
 
-                        if ((args = malloc(sizeof(*args))) == NULL)
+                        if ((args = op_alloc(sizeof(*args))) == NULL)
                                 OOM_ABORT;
                         op->op_args = args;
                         op->op = TRANSFORM;
                         cairo_matrix_init(&args->matrix, xx, yx, xy, yy, x0, y0);
-                } else if (sscanf(raw_args, " %c", &dummy) < 1) {
+                } else if (ud->bin_len == 0 && sscanf(raw_args, " %c", &dummy) < 1) {
                         op->op = RESET_CTM;
                         op->op_args = NULL;
                 } else
                         return FAILURE;
-        } else if (eql(action, "translate")) {
+                break;
+        }
+        case ACT_TRANSLATE: {
                 double tx, ty;
                 struct transform_args *args;
 
-                if ((args = malloc(sizeof(*args))) == NULL)
+                if ((args = op_alloc(sizeof(*args))) == NULL)
                         OOM_ABORT;
                 op->op = TRANSFORM;
                 op->op_args = args;
-                if (sscanf(raw_args, "%lf %lf %c", &tx, &ty, &dummy) != 2)
+                if (!scan_doubles(ud, raw_args, 2, &tx, &ty))
                         return FAILURE;
                 cairo_matrix_init_translate(&args->matrix, tx, ty);
-        } else if (eql(action, "scale")) {
+                break;
+        }
+        case ACT_SCALE: {
                 double sx, sy;
                 struct transform_args *args;
 
-                if ((args = malloc(sizeof(*args))) == NULL)
+                if ((args = op_alloc(sizeof(*args))) == NULL)
                         OOM_ABORT;
                 op->op = TRANSFORM;
                 op->op_args = args;
-                if (sscanf(raw_args, "%lf %lf %c", &sx, &sy, &dummy) != 2)
+                if (!scan_doubles(ud, raw_args, 2, &sx, &sy))
                         return FAILURE;
                 cairo_matrix_init_scale(&args->matrix, sx, sy);
-        } else if (eql(action, "rotate")) {
+                break;
+        }
+        case ACT_ROTATE: {
                 double angle;
                 struct transform_args *args;
 
-                if ((args = malloc(sizeof(*args))) == NULL)
+                if ((args = op_alloc(sizeof(*args))) == NULL)
                         OOM_ABORT;
                 op->op = TRANSFORM;
                 op->op_args = args;
-                if (sscanf(raw_args, "%lf %c", &angle, &dummy) != 1)
+                if (!scan_doubles(ud, raw_args, 1, &angle))
                         return FAILURE;
                 cairo_matrix_init_rotate(&args->matrix, angle * (M_PI / 180.L));
-        } else
+                break;
+        }
+        default:
                 return FAILURE;
+        }
         return result;
 }
 
 /*
- * Add another element to widget's "draw_ops" list
+ * A new empty drawing or layer
  */
-static enum draw_op_stat
-ins_draw_op(GObject *widget, const char *action, const char *data)
+static struct drawing *
+new_drawing(const char *name)
 {
-        enum draw_op_stat result;
-        struct draw_op *new_op = NULL, *draw_ops = NULL, *prev_op = NULL;
+        struct drawing *d;
 
-        if ((new_op = malloc(sizeof(*new_op))) == NULL)
+        if ((d = malloc(sizeof(*d))) == NULL)
                 OOM_ABORT;
-        new_op->op_args = NULL;
-        new_op->next = NULL;
-        if ((result = set_draw_op(new_op, action, data)) == FAILURE) {
-                free(new_op->op_args);
-                free(new_op);
-                return FAILURE;
+        d->first = d->last = NULL;
+        d->ids = g_hash_table_new(g_int64_hash, g_int64_equal);
+        d->damage = cairo_region_create();
+        d->damage_all = false;
+        d->changed = false;
+        d->refresh_pending = false;
+        d->layers = NULL;
+        d->target = d;
+        if (name == NULL)
+                d->name = NULL;
+        else if ((d->name = strdup(name)) == NULL)
+                OOM_ABORT;
+        d->next = NULL;
+        d->cache = NULL;
+        d->canvas = NULL;
+        d->canvas_cr = NULL;
+        d->decimate = false;
+        d->tile_size = 0;
+        d->files_version = vertex_files_version;
+        return d;
+}
+
+/*
+ * The drawing of widget, created on first use
+ */
+static struct drawing *
+get_drawing(GObject *widget)
+{
+        struct drawing *d;
+
+        if ((d = g_object_get_data(widget, "drawing")) == NULL) {
+                d = new_drawing(NULL);
+                g_object_set_data(widget, "drawing", d);
         }
-        switch (new_op->policy) {
-        case APPEND:
-                if ((draw_ops = g_object_get_data(widget, "draw_ops")) == NULL)
-                        g_object_set_data(widget, "draw_ops", new_op);
-                else {
-                        for (prev_op = draw_ops;
-                             prev_op->next != NULL;
-                             prev_op = prev_op->next);
-                        prev_op->next = new_op;
-                }
-                break;
-        case BEFORE:
-                for (prev_op = NULL, draw_ops = g_object_get_data(widget, "draw_ops");
-                     draw_ops != NULL && draw_ops->id != new_op->before;
-                     prev_op = draw_ops, draw_ops = draw_ops->next);
-                if (prev_op == NULL) { /* prepend a new first element */
-                        g_object_set_data(widget, "draw_ops", new_op);
-                        new_op->next = draw_ops;
-                } else if (draw_ops == NULL) /* append */
-                        prev_op->next = new_op;
-                else {          /* insert */
-                        new_op->next = draw_ops;
-                        prev_op->next = new_op;
-                }
-                break;
-        case REPLACE:
-                for (prev_op = NULL, draw_ops = g_object_get_data(widget, "draw_ops");
-                     draw_ops != NULL && draw_ops->id != new_op->id;
-                     prev_op = draw_ops, draw_ops = draw_ops->next);
-                if (draw_ops == NULL && prev_op == NULL) /* start a new list */
-                        g_object_set_data(widget, "draw_ops", new_op);
-                else if (prev_op == NULL) { /* replace the first element */
-                        g_object_set_data(widget, "draw_ops", new_op);
-                        new_op->next = draw_ops->next;
-                        free(draw_ops->op_args);
-                        free(draw_ops);
-                } else if (draw_ops == NULL) /* append */
-                        prev_op->next = new_op;
-                else {          /* replace some other element */
-                        new_op->next = draw_ops->next;
-                        prev_op->next = new_op;
-                        free(draw_ops->op_args);
-                        free(draw_ops);
-                }
-                break;
-        default:
-                ABORT;
-                break;
+        return d;
+}
+
+/*
+ * Direct widget's subsequent drawing commands to the layer named in
+ * data, creating it on top of the others if necessary, or back to the
+ * uncached drawing above all layers if data is blank
+ */
+static bool
+select_layer(GObject *widget, const char *data)
+{
+        bool ok = true;
+        char *name, dummy;
+        int n;
+        struct drawing *d = get_drawing(widget), **l;
+
+        if ((name = malloc(strlen(data) + 1)) == NULL)
+                OOM_ABORT;
+        if ((n = sscanf(data, " %s %c", name, &dummy)) < 1)
+                d->target = d;
+        else if (n > 1)
+                ok = false;
+        else {
+                for (l = &d->layers;
+                     *l != NULL && !eql((*l)->name, name);
+                     l = &(*l)->next);
+                if (*l == NULL)
+                        *l = new_drawing(name);
+                d->target = *l;
         }
-        return result;
+        free(name);
+        return ok;
 }
 
 /*
- * Remove all elements with the given id from widget's "draw_ops" list
+ * Turn decimation of long paths of widget on or off, and have all of
+ * its drawing, layers included, redrawn accordingly
  */
 static enum draw_op_stat
-rem_draw_op(GObject *widget, const char *data)
+set_decimate(GObject *widget, const char *data)
 {
         char dummy;
-        struct draw_op *op, *next_op, *prev_op = NULL;
-        unsigned long long int id;
+        int on;
+        struct drawing *d = get_drawing(widget), *l;
 
-        if (sscanf(data, "%llu %c", &id, &dummy) != 1)
+        if (sscanf(data, "%d %c", &on, &dummy) != 1 || (on != 0 && on != 1))
                 return FAILURE;
-        op = g_object_get_data(widget, "draw_ops");
-        while (op != NULL) {
-                next_op = op->next;
-                if (op->id == id) {
-                        if (prev_op == NULL) /* list head */
-                                g_object_set_data(widget, "draw_ops", op->next);
-                        else
-                                prev_op->next = op->next;
-                        free(op->op_args);
-                        free(op);
-                } else
-                        prev_op = op;
-                op = next_op;
-        }
+        if (d->decimate == on)
+                return SUCCESS;
+        d->decimate = on;
+        touch_drawing(d);
+        for (l = d->layers; l != NULL; l = l->next)
+                touch_drawing(l);
+        d->damage_all = true;
         return NEED_REDRAW;
 }
 
-static gboolean
-refresh_widget(GtkWidget *widget)
+/*
+ * Set the size of the tiles widget's drawing is rendered in, or turn
+ * tiled rendering off
+ */
+static bool
+set_tiles(GObject *widget, const char *data)
 {
-        gint height = gtk_widget_get_allocated_height(widget);
-        gint width = gtk_widget_get_allocated_width(widget);
+        char dummy;
+        int size;
 
-        gtk_widget_queue_draw_area(widget, 0, 0, width, height);
-        return G_SOURCE_REMOVE;
+        if (sscanf(data, "%d %c", &size, &dummy) != 1 ||
+            size < 0 || (size > 0 && size < MIN_TILE_SIZE))
+                return false;
+        get_drawing(widget)->tile_size = size;
+        return true;
 }
 
+#define RANK_STEP (1ULL << 32)
+
+/*
+ * Link op into drawing d in front of next, or at the end if next is
+ * NULL, and give it a rank between those of its neighbours.  Where
+ * there is no room, rank the whole list anew.
+ */
 static void
-update_drawing_area(struct ui_data *ud)
+link_draw_op(struct drawing *d, struct draw_op *op, struct draw_op *next)
 {
-        enum draw_op_stat dost;
+        unsigned long long int lo, hi;
 
-        if (eql(ud->action, "remove"))
-                dost = rem_draw_op(ud->obj, ud->data);
+        op->next = next;
+        op->prev = next == NULL ? d->last : next->prev;
+        if (op->prev == NULL)
+                d->first = op;
         else
-                dost = ins_draw_op(ud->obj, ud->action, ud->data);
-        switch (dost) {
-        case NEED_REDRAW:
-                gdk_threads_add_idle_full(G_PRIORITY_LOW,
-                                          (GSourceFunc) refresh_widget,
-                                          GTK_WIDGET(ud->obj), NULL);
+                op->prev->next = op;
+        if (next == NULL)
+                d->last = op;
+        else
+                next->prev = op;
+        lo = op->prev == NULL ? 0 : op->prev->rank;
+        hi = op->next == NULL ? ULLONG_MAX : op->next->rank;
+        if (op->next == NULL && hi - lo > RANK_STEP)
+                op->rank = lo + RANK_STEP;
+        else if (op->prev == NULL && hi - lo > RANK_STEP)
+                op->rank = hi - RANK_STEP;
+        else if (hi - lo >= 2)
+                op->rank = lo + (hi - lo) / 2;
+        else
+                for (lo = ULLONG_MAX / 4, op = d->first;
+                     op != NULL;
+                     lo += RANK_STEP, op = op->next)
+                        op->rank = lo;
+}
+
+/*
+ * Store into op the device space extents of painting operation op,
+ * and have it take effect on the path and current point of cr
+ * without actually painting
+ */
+static void
+measure_draw_op(cairo_t *cr, struct draw_op *op)
+{
+        cairo_text_extents_t e;
+        double x1, y1, x2, y2, x = 0.0, y = 0.0;
+
+        switch (op->op) {
+        case FILL:
+        case FILL_PRESERVE:
+                cairo_fill_extents(cr, &x1, &y1, &x2, &y2);
                 break;
-        case FAILURE:
-                try_generic_cmds(ud);
+        case STROKE:
+        case STROKE_PRESERVE:
+                cairo_stroke_extents(cr, &x1, &y1, &x2, &y2);
                 break;
-        case SUCCESS:
+        case SHOW_TEXT:
+                cairo_text_extents(cr, ((struct show_text_args *) op->op_args)->text, &e);
+                if (cairo_has_current_point(cr))
+                        cairo_get_current_point(cr, &x, &y);
+                x1 = x + e.x_bearing;
+                y1 = y + e.y_bearing;
+                x2 = x1 + e.width;
+                y2 = y1 + e.height;
+                cairo_move_to(cr, x + e.x_advance, y + e.y_advance);
                 break;
         default:
                 ABORT;
                 break;
         }
+        device_box(cr, x1, y1, x2, y2, &op->extents);
+        op->has_extents = true;
 }
 
+/*
+ * Make the canvas of drawing d at least as large as widget is or asks
+ * to be, keeping its contents and drawing state
+ */
 static void
-update_entry(struct ui_data *ud)
+fit_canvas(GtkWidget *widget, struct drawing *d)
 {
-        GtkEntry *entry = GTK_ENTRY(ud->obj);
-
-        if (eql(ud->action, "set_text"))
-                gtk_entry_set_text(entry, ud->data);
-        else if (eql(ud->action, "set_placeholder_text"))
-                gtk_entry_set_placeholder_text(entry, ud->data);
-        else
-                try_generic_cmds(ud);
+        cairo_matrix_t m;
+        cairo_path_t *path;
+        cairo_surface_t *surface;
+        cairo_t *cr, *old = d->canvas_cr;
+        double *dashes, offset;
+        int height = cairo_image_surface_get_height(d->canvas);
+        int width = cairo_image_surface_get_width(d->canvas);
+        int n, h, w;
+
+        gtk_widget_get_size_request(widget, &w, &h);
+        h = MAX(h, gtk_widget_get_allocated_height(widget));
+        w = MAX(w, gtk_widget_get_allocated_width(widget));
+        if (h <= height && w <= width)
+                return;
+        height = MAX(height, h);
+        width = MAX(width, w);
+        surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, width, height);
+        cr = cairo_create(surface);
+        cairo_set_source_surface(cr, d->canvas, 0, 0);
+        cairo_paint(cr);
+        cairo_set_source(cr, cairo_get_source(old));
+        cairo_set_line_width(cr, cairo_get_line_width(old));
+        cairo_set_line_cap(cr, cairo_get_line_cap(old));
+        cairo_set_line_join(cr, cairo_get_line_join(old));
+        n = cairo_get_dash_count(old);
+        if ((dashes = malloc((n + 1) * sizeof(*dashes))) == NULL)
+                OOM_ABORT;
+        cairo_get_dash(old, dashes, &offset);
+        cairo_set_dash(cr, dashes, n, offset);
+        free(dashes);
+        cairo_set_font_face(cr, cairo_get_font_face(old));
+        cairo_get_font_matrix(old, &m);
+        cairo_set_font_matrix(cr, &m);
+        cairo_get_matrix(old, &m);
+        cairo_set_matrix(cr, &m);
+        path = cairo_copy_path(old);
+        cairo_append_path(cr, path);
+        cairo_path_destroy(path);
+        cairo_destroy(old);
+        cairo_surface_destroy(d->canvas);
+        d->canvas = surface;
+        d->canvas_cr = cr;
 }
 
-static void
-update_expander(struct ui_data *ud)
+/*
+ * Paint op onto the canvas of drawing d of widget, noting the damage
+ */
+static enum draw_op_stat
+paint_on_canvas(GtkWidget *widget, struct drawing *d, struct draw_op *op)
 {
-        GtkExpander *expander = GTK_EXPANDER(ud->obj);
-        char dummy;
-        unsigned int val;
+        double x = 0.0, y = 0.0;
 
-        if (eql(ud->action, "set_expanded") &&
-            sscanf(ud->data, "%u %c", &val, &dummy) == 1 && val < 2)
-                gtk_expander_set_expanded(expander, val);
-        else if (eql(ud->action, "set_label"))
-                gtk_expander_set_label(expander, ud->data);
-        else
-                try_generic_cmds(ud);
+        fit_canvas(widget, d);
+        if (op_kind(op->op) != PAINTS) {
+                draw(d->canvas_cr, op->op, op->op_args, d->decimate);
+                return SUCCESS;
+        }
+        if (cairo_has_current_point(d->canvas_cr))
+                cairo_get_current_point(d->canvas_cr, &x, &y);
+        measure_draw_op(d->canvas_cr, op);
+        if (op->op == SHOW_TEXT)
+                cairo_move_to(d->canvas_cr, x, y);
+        cairo_region_union_rectangle(d->damage, &op->extents);
+        draw(d->canvas_cr, op->op, op->op_args, d->decimate);
+        return NEED_REDRAW;
 }
 
-static void
-update_file_chooser_button(struct ui_data *ud)
+/*
+ * Turn the persistent canvas of widget on or off; off discards it
+ */
+static enum draw_op_stat
+set_canvas(GObject *widget, const char *data)
+{
+        char dummy;
+        int on;
+        struct drawing *d = get_drawing(widget);
+
+        if (sscanf(data, "%d %c", &on, &dummy) != 1 || (on != 0 && on != 1))
+                return FAILURE;
+        if (on && d->canvas == NULL) {
+                d->canvas = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, 1, 1);
+                d->canvas_cr = cairo_create(d->canvas);
+                return SUCCESS;
+        }
+        if (!on && d->canvas != NULL) {
+                cairo_destroy(d->canvas_cr);
+                cairo_surface_destroy(d->canvas);
+                d->canvas = NULL;
+                d->canvas_cr = NULL;
+                d->damage_all = true;
+                return NEED_REDRAW;
+        }
+        return SUCCESS;
+}
+
+/*
+ * Add another element to widget's drawing
+ */
+static enum draw_op_stat
+ins_draw_op(GObject *widget, const struct ui_data *ud)
+{
+        enum draw_op_stat result;
+        struct draw_op *new_op = NULL, *op = NULL;
+        struct drawing *d;
+
+        if ((new_op = op_alloc(sizeof(*new_op))) == NULL)
+                OOM_ABORT;
+        new_op->op_args = NULL;
+        new_op->dirty = true;
+        new_op->has_extents = false;
+        if ((result = set_draw_op(new_op, ud)) == FAILURE) {
+                free_op_args(new_op);
+                op_free(new_op);
+                return FAILURE;
+        }
+        d = get_drawing(widget)->target;
+        if (d->canvas != NULL) {
+                result = paint_on_canvas(GTK_WIDGET(widget), d, new_op);
+                free_op_args(new_op);
+                op_free(new_op);
+                return result;
+        }
+        touch_drawing(d);
+        switch (new_op->policy) {
+        case APPEND:
+                link_draw_op(d, new_op, NULL);
+                break;
+        case BEFORE:    /* append if there is no such element */
+                link_draw_op(d, new_op,
+                             g_hash_table_lookup(d->ids, &new_op->before));
+                break;
+        case REPLACE:
+                if ((op = g_hash_table_lookup(d->ids, &new_op->id)) != NULL) {
+                        if (op->has_extents)
+                                cairo_region_union_rectangle(d->damage,
+                                                             &op->extents);
+                        op->has_extents = false;
+                        op->dirty = true;
+                        if (op_kind(op->op) == STATE)
+                                d->damage_all = true;
+                        free_op_args(op);
+                        op->op = new_op->op;
+                        op->op_args = new_op->op_args;
+                        op_free(new_op);
+                        return result;
+                }
+                link_draw_op(d, new_op, NULL);
+                break;
+        default:
+                ABORT;
+                break;
+        }
+        if ((op = g_hash_table_lookup(d->ids, &new_op->id)) == NULL) {
+                new_op->same_id = NULL;
+                g_hash_table_replace(d->ids, &new_op->id, new_op);
+        } else if (new_op->rank < op->rank) {
+                new_op->same_id = op;
+                g_hash_table_replace(d->ids, &new_op->id, new_op);
+        } else {
+                new_op->same_id = op->same_id;
+                op->same_id = new_op;
+        }
+        return result;
+}
+
+/*
+ * Remove all elements with the given id from widget's drawing
+ */
+static enum draw_op_stat
+rem_draw_op(GObject *widget, const char *data)
+{
+        char dummy;
+        struct draw_op *op, *next_op;
+        struct drawing *d = get_drawing(widget)->target;
+        unsigned long long int id;
+
+        if (sscanf(data, "%llu %c", &id, &dummy) != 1)
+                return FAILURE;
+        touch_drawing(d);
+        op = g_hash_table_lookup(d->ids, &id);
+        g_hash_table_remove(d->ids, &id);
+        for (; op != NULL; op = next_op) {
+                next_op = op->same_id;
+                if (op->has_extents)
+                        cairo_region_union_rectangle(d->damage, &op->extents);
+                if (op_kind(op->op) == STATE)
+                        d->damage_all = true;
+                else if (op->next != NULL)
+                        op->next->dirty = true;
+                if (op->prev == NULL)
+                        d->first = op->next;
+                else
+                        op->prev->next = op->next;
+                if (op->next == NULL)
+                        d->last = op->prev;
+                else
+                        op->next->prev = op->prev;
+                free_op_args(op);
+                op_free(op);
+        }
+        return NEED_REDRAW;
+}
+
+/*
+ * Append the samples in ud to the time series whose id is the first
+ * number in ud
+ */
+static enum draw_op_stat
+add_samples(GObject *widget, const struct ui_data *ud)
+{
+        char dummy, *end;
+        const char *next;
+        int n, i, start = 0;
+        struct draw_op *op;
+        struct drawing *d = get_drawing(widget)->target;
+        struct series_args *args;
+        unsigned long long int id;
+
+        if (sscanf(ud->data, "%llu %n", &id, &start) != 1)
+                return FAILURE;
+        for (op = g_hash_table_lookup(d->ids, &id);
+             op != NULL && op->op != SERIES; op = op->same_id)
+                ;
+        if (op == NULL)
+                return FAILURE;
+        for (n = 0, next = ud->data + start;; n++, next = end) {
+                strtod(next, &end);
+                if (end == next)
+                        break;
+        }
+        if (sscanf(next, " %c", &dummy) > 0 ||
+            (ud->bin != NULL && (n > 0 || ud->bin_len % sizeof(double) != 0)))
+                return FAILURE;
+        args = op->op_args;
+        if (ud->bin != NULL)
+                n = ud->bin_len / sizeof(double);
+        for (i = 0, next = ud->data + start; i < n; i++, next = end) {
+                if (ud->bin != NULL)
+                        memcpy(args->samples + args->head,
+                               ud->bin + i * sizeof(double), sizeof(double));
+                else
+                        args->samples[args->head] = strtod(next, &end);
+                args->head = (args->head + 1) % args->capacity;
+        }
+        args->count = MIN(args->count + n, args->capacity);
+        free_lod(&args->lod);
+        op->dirty = true;
+        touch_drawing(d);
+        return NEED_REDRAW;
+}
+
+/*
+ * While a transaction is being committed or, with option -F, the queue
+ * drained for a frame, drawing areas to refresh once it's done.  Used
+ * inside gtk_main() only.
+ */
+static GHashTable *deferred_redraws = NULL;
+
+/*
+ * Replay drawing d without painting, updating the extents of those
+ * painting operations that may have changed, and add to d's damage
+ * what they covered before and what they cover now
+ */
+static void
+measure_drawing(struct drawing *d, bool decimate)
+{
+        bool path_dirty = false, after_dirty = d->damage_all;
+        cairo_surface_t *surface;
+        cairo_t *cr;
+        struct draw_op *op;
+
+        if (!d->changed)
+                return;
+        surface = cairo_image_surface_create(CAIRO_FORMAT_A1, 1, 1);
+        cr = cairo_create(surface);
+        for (op = d->first; op != NULL; op = op->next) {
+                switch (op_kind(op->op)) {
+                case PATH:
+                        draw(cr, op->op, op->op_args, decimate);
+                        path_dirty = path_dirty || op->dirty;
+                        break;
+                case STATE:
+                        draw(cr, op->op, op->op_args, decimate);
+                        after_dirty = after_dirty || op->dirty;
+                        break;
+                case PAINTS:
+                        if (op->dirty || path_dirty || after_dirty) {
+                                if (op->has_extents)
+                                        cairo_region_union_rectangle(d->damage,
+                                                                     &op->extents);
+                                measure_draw_op(cr, op);
+                                cairo_region_union_rectangle(d->damage,
+                                                             &op->extents);
+                        } else if (op->op == SHOW_TEXT)
+                                measure_draw_op(cr, op);
+                        if (op->op == FILL || op->op == STROKE) {
+                                cairo_new_path(cr);
+                                path_dirty = op->dirty;
+                        } else
+                                path_dirty = path_dirty || op->dirty;
+                        break;
+                default:
+                        ABORT;
+                        break;
+                }
+                op->dirty = false;
+        }
+        cairo_destroy(cr);
+        cairo_surface_destroy(surface);
+        d->changed = false;
+}
+
+/*
+ * Queue redraws of whatever has changed in the drawing of widget and
+ * its layers
+ */
+static gboolean
+refresh_widget(GtkWidget *widget)
+{
+        struct drawing *d = get_drawing(G_OBJECT(widget)), *l;
+
+        sync_vertex_files();
+        catch_up_vertex_files(d);
+        measure_drawing(d, d->decimate);
+        for (l = d->layers; l != NULL; l = l->next) {
+                measure_drawing(l, d->decimate);
+                d->damage_all = d->damage_all || l->damage_all;
+                cairo_region_union(d->damage, l->damage);
+                cairo_region_destroy(l->damage);
+                l->damage = cairo_region_create();
+                l->damage_all = false;
+        }
+        if (d->damage_all)
+                gtk_widget_queue_draw(widget);
+        else
+                gtk_widget_queue_draw_region(widget, d->damage);
+        cairo_region_destroy(d->damage);
+        d->damage = cairo_region_create();
+        d->damage_all = false;
+        d->refresh_pending = false;
+        return G_SOURCE_REMOVE;
+}
+
+/*
+ * Refresh the drawing areas collected in deferred_redraws, and go
+ * back to collecting them in outer, if that isn't NULL
+ */
+static void
+refresh_deferred(GHashTable *outer)
+{
+        GHashTableIter iter;
+        void *widget;
+
+        g_hash_table_iter_init(&iter, deferred_redraws);
+        while (g_hash_table_iter_next(&iter, &widget, NULL))
+                refresh_widget(widget);
+        g_hash_table_destroy(deferred_redraws);
+        deferred_redraws = outer;
+}
+
+static void
+update_drawing_area(struct ui_data *ud)
+{
+        enum draw_op_stat dost;
+        struct drawing *d;
+
+        if (ud->act == ACT_CANVAS)
+                dost = set_canvas(ud->obj, ud->data);
+        else if (ud->act == ACT_DECIMATE)
+                dost = set_decimate(ud->obj, ud->data);
+        else if (ud->act == ACT_TILES)
+                dost = set_tiles(ud->obj, ud->data) ? SUCCESS : FAILURE;
+        else if (ud->act == ACT_LAYER)
+                dost = select_layer(ud->obj, ud->data) ? SUCCESS : FAILURE;
+        else if (ud->act == ACT_REMOVE)
+                dost = rem_draw_op(ud->obj, ud->data);
+        else if (ud->act == ACT_SERIES_ADD)
+                dost = add_samples(ud->obj, ud);
+        else
+                dost = ins_draw_op(ud->obj, ud);
+        switch (dost) {
+        case NEED_REDRAW:
+                d = get_drawing(ud->obj);
+                if (deferred_redraws != NULL)
+                        g_hash_table_add(deferred_redraws, ud->obj);
+                else if (!d->refresh_pending) {
+                        d->refresh_pending = true;
+                        gdk_threads_add_idle_full(G_PRIORITY_LOW,
+                                                  (GSourceFunc) refresh_widget,
+                                                  GTK_WIDGET(ud->obj), NULL);
+                }
+                break;
+        case FAILURE:
+                try_generic_cmds(ud);
+                break;
+        case SUCCESS:
+                break;
+        default:
+                ABORT;
+                break;
+        }
+}
+
+static void
+update_entry(struct ui_data *ud)
+{
+        GtkEntry *entry = GTK_ENTRY(ud->obj);
+
+        if (ud->act == ACT_SET_TEXT)
+                gtk_entry_set_text(entry, ud->data);
+        else if (ud->act == ACT_SET_PLACEHOLDER_TEXT)
+                gtk_entry_set_placeholder_text(entry, ud->data);
+        else
+                try_generic_cmds(ud);
+}
+
+static void
+update_expander(struct ui_data *ud)
+{
+        GtkExpander *expander = GTK_EXPANDER(ud->obj);
+        char dummy;
+        unsigned int val;
+
+        if (ud->act == ACT_SET_EXPANDED &&
+            sscanf(ud->data, "%u %c", &val, &dummy) == 1 && val < 2)
+                gtk_expander_set_expanded(expander, val);
+        else if (ud->act == ACT_SET_LABEL)
+                gtk_expander_set_label(expander, ud->data);
+        else
+                try_generic_cmds(ud);
+}
+
+static void
+update_file_chooser_button(struct ui_data *ud)
 {
-        if (eql(ud->action, "set_filename"))
+        if (ud->act == ACT_SET_FILENAME)
                 gtk_file_chooser_set_filename(GTK_FILE_CHOOSER(ud->obj), ud->data);
         else
                 try_generic_cmds(ud);
@@ -2150,9 +4524,9 @@ update_file_chooser_dialog(struct ui_data *ud)
 {
         GtkFileChooser *chooser = GTK_FILE_CHOOSER(ud->obj);
 
-        if (eql(ud->action, "set_filename"))
+        if (ud->act == ACT_SET_FILENAME)
                 gtk_file_chooser_set_filename(chooser, ud->data);
-        else if (eql(ud->action, "set_current_name"))
+        else if (ud->act == ACT_SET_CURRENT_NAME)
                 gtk_file_chooser_set_current_name(chooser, ud->data);
         else if (update_class_window(ud));
         else
@@ -2163,7 +4537,7 @@ static void
 update_font_button(struct ui_data *ud){
         GtkFontButton *font_button = GTK_FONT_BUTTON(ud->obj);
 
-        if (eql(ud->action, "set_font_name"))
+        if (ud->act == ACT_SET_FONT_NAME)
                 gtk_font_button_set_font_name(font_button, ud->data);
         else
                 try_generic_cmds(ud);
@@ -2172,7 +4546,7 @@ update_font_button(struct ui_data *ud){
 static void
 update_frame(struct ui_data *ud)
 {
-        if (eql(ud->action, "set_label"))
+        if (ud->act == ACT_SET_LABEL)
                 gtk_frame_set_label(GTK_FRAME(ud->obj), ud->data);
         else
                 try_generic_cmds(ud);
@@ -2185,9 +4559,9 @@ update_image(struct ui_data *ud)
         GtkImage *image = GTK_IMAGE(ud->obj);
 
         gtk_image_get_icon_name(image, NULL, &size);
-        if (eql(ud->action, "set_from_file"))
+        if (ud->act == ACT_SET_FROM_FILE)
                 gtk_image_set_from_file(image, ud->data);
-        else if (eql(ud->action, "set_from_icon_name"))
+        else if (ud->act == ACT_SET_FROM_ICON_NAME)
                 gtk_image_set_from_icon_name(image, ud->data, size);
         else
                 try_generic_cmds(ud);
@@ -2196,7 +4570,7 @@ update_image(struct ui_data *ud)
 static void
 update_label(struct ui_data *ud)
 {
-        if (eql(ud->action, "set_text"))
+        if (ud->act == ACT_SET_TEXT)
                 gtk_label_set_text(GTK_LABEL(ud->obj), ud->data);
         else
                 try_generic_cmds(ud);
@@ -2208,7 +4582,7 @@ update_link_button(struct ui_data *ud)
         char dummy;
         unsigned int val;
 
-        if (eql(ud->action, "set_visited") &&
+        if (ud->act == ACT_SET_VISITED &&
             sscanf(ud->data, "%u %c", &val, &dummy) == 1 && val < 2)
                 gtk_link_button_set_visited(GTK_LINK_BUTTON(ud->obj), val);
         else
@@ -2221,10 +4595,10 @@ update_menu(struct ui_data *ud)
         char dummy;
         GtkMenu* menu = GTK_MENU(ud->obj);
 
-        if (eql(ud->action, "popup") && sscanf(ud->data, " %c", &dummy) < 1)
+        if (ud->act == ACT_POPUP && sscanf(ud->data, " %c", &dummy) < 1)
                 gtk_menu_popup(menu, NULL, NULL, NULL, NULL, 0,
                                gtk_get_current_event_time());
-        else if (eql(ud->action, "popdown") && sscanf(ud->data, " %c", &dummy) < 1)
+        else if (ud->act == ACT_POPDOWN && sscanf(ud->data, " %c", &dummy) < 1)
                 gtk_menu_popdown(menu);
         else
                 try_generic_cmds(ud);
@@ -2242,7 +4616,7 @@ update_notebook(struct ui_data *ud)
         char dummy;
         int val, n_pages = gtk_notebook_get_n_pages(GTK_NOTEBOOK(ud->obj));
 
-        if (eql(ud->action, "set_current_page") &&
+        if (ud->act == ACT_SET_CURRENT_PAGE &&
             sscanf(ud->data, "%d %c", &val, &dummy) == 1 &&
             val >= 0 && val < n_pages)
                 gtk_notebook_set_current_page(GTK_NOTEBOOK(ud->obj), val);
@@ -2266,7 +4640,7 @@ update_print_dialog(struct ui_data *ud)
         GtkPrinter *printer;
         gint response_id;
 
-        if (eql(ud->action, "print")) {
+        if (ud->act == ACT_PRINT) {
                 response_id = gtk_dialog_run(GTK_DIALOG(dialog));
                 switch (response_id) {
                 case GTK_RESPONSE_OK:
@@ -2301,9 +4675,9 @@ update_progress_bar(struct ui_data *ud)
         char dummy;
         double frac;
 
-        if (eql(ud->action, "set_text"))
+        if (ud->act == ACT_SET_TEXT)
                 gtk_progress_bar_set_text(progressbar, *(ud->data) == '\0' ? NULL : ud->data);
-        else if (eql(ud->action, "set_fraction") &&
+        else if (ud->act == ACT_SET_FRACTION &&
                  sscanf(ud->data, "%lf %c", &frac, &dummy) == 1)
                 gtk_progress_bar_set_fraction(progressbar, frac);
         else
@@ -2317,19 +4691,19 @@ update_scale(struct ui_data *ud)
         char dummy;
         double val1, val2;
 
-        if (eql(ud->action, "set_value") && sscanf(ud->data, "%lf %c", &val1, &dummy) == 1)
+        if (ud->act == ACT_SET_VALUE && sscanf(ud->data, "%lf %c", &val1, &dummy) == 1)
                 gtk_range_set_value(range, val1);
-        else if (eql(ud->action, "set_fill_level") &&
+        else if (ud->act == ACT_SET_FILL_LEVEL &&
                  sscanf(ud->data, "%lf %c", &val1, &dummy) == 1) {
                 gtk_range_set_fill_level(range, val1);
                 gtk_range_set_show_fill_level(range, TRUE);
-        } else if (eql(ud->action, "set_fill_level") &&
+        } else if (ud->act == ACT_SET_FILL_LEVEL &&
                    sscanf(ud->data, " %c", &dummy) < 1)
                 gtk_range_set_show_fill_level(range, FALSE);
-        else if (eql(ud->action, "set_range") &&
+        else if (ud->act == ACT_SET_RANGE &&
                  sscanf(ud->data, "%lf %lf %c", &val1, &val2, &dummy) == 2)
                 gtk_range_set_range(range, val1, val2);
-        else if (eql(ud->action, "set_increments") &&
+        else if (ud->act == ACT_SET_INCREMENTS &&
                  sscanf(ud->data, "%lf %lf %c", &val1, &val2, &dummy) == 2)
                 gtk_range_set_increments(range, val1, val2);
         else
@@ -2345,14 +4719,14 @@ update_scrolled_window(struct ui_data *ud)
         char dummy;
         double d0, d1;
 
-        if (eql(ud->action, "hscroll") && sscanf(ud->data, "%lf %c", &d0, &dummy) == 1)
+        if (ud->act == ACT_HSCROLL && sscanf(ud->data, "%lf %c", &d0, &dummy) == 1)
                 gtk_adjustment_set_value(hadj, d0);
-        else if (eql(ud->action, "vscroll") && sscanf(ud->data, "%lf %c", &d0, &dummy) == 1)
+        else if (ud->act == ACT_VSCROLL && sscanf(ud->data, "%lf %c", &d0, &dummy) == 1)
                 gtk_adjustment_set_value(vadj, d0);
-        else if (eql(ud->action, "hscroll_to_range") &&
+        else if (ud->act == ACT_HSCROLL_TO_RANGE &&
                  sscanf(ud->data, "%lf %lf %c", &d0, &d1, &dummy) == 2)
                 gtk_adjustment_clamp_page(hadj, d0, d1);
-        else if (eql(ud->action, "vscroll_to_range") &&
+        else if (ud->act == ACT_VSCROLL_TO_RANGE &&
                  sscanf(ud->data, "%lf %lf %c", &d0, &d1, &dummy) == 2)
                 gtk_adjustment_clamp_page(vadj, d0, d1);
         else
@@ -2366,9 +4740,10 @@ update_socket(struct ui_data *ud)
         Window id;
         char str[BUFLEN], dummy;
 
-        if (eql(ud->action, "id") && sscanf(ud->data, " %c", &dummy) < 1) {
+        if (ud->act == ACT_ID && sscanf(ud->data, " %c", &dummy) < 1) {
                 id = gtk_socket_get_id(socket);
                 snprintf(str, BUFLEN, "%lu", id);
+                route_reply(ud);
                 send_msg(ud->args->fout, GTK_BUILDABLE(socket), "id", str, NULL);
         } else
                 try_generic_cmds(ud);
@@ -2381,13 +4756,13 @@ update_spin_button(struct ui_data *ud)
         char dummy;
         double val1, val2;
 
-        if (eql(ud->action, "set_text") && /* TODO: rename to "set_value" */
+        if (ud->act == ACT_SET_TEXT && /* TODO: rename to "set_value" */
             sscanf(ud->data, "%lf %c", &val1, &dummy) == 1)
                 gtk_spin_button_set_value(spinbutton, val1);
-        else if (eql(ud->action, "set_range") &&
+        else if (ud->act == ACT_SET_RANGE &&
                  sscanf(ud->data, "%lf %lf %c", &val1, &val2, &dummy) == 2)
                 gtk_spin_button_set_range(spinbutton, val1, val2);
-        else if (eql(ud->action, "set_increments") &&
+        else if (ud->act == ACT_SET_INCREMENTS &&
                  sscanf(ud->data, "%lf %lf %c", &val1, &val2, &dummy) == 2)
                 gtk_spin_button_set_increments(spinbutton, val1, val2);
         else
@@ -2400,9 +4775,9 @@ update_spinner(struct ui_data *ud)
         GtkSpinner *spinner = GTK_SPINNER(ud->obj);
         char dummy;
 
-        if (eql(ud->action, "start") && sscanf(ud->data, " %c", &dummy) < 1)
+        if (ud->act == ACT_START && sscanf(ud->data, " %c", &dummy) < 1)
                 gtk_spinner_start(spinner);
-        else if (eql(ud->action, "stop") && sscanf(ud->data, " %c", &dummy) < 1)
+        else if (ud->act == ACT_STOP && sscanf(ud->data, " %c", &dummy) < 1)
                 gtk_spinner_stop(spinner);
         else
                 try_generic_cmds(ud);
@@ -2421,24 +4796,24 @@ update_statusbar(struct ui_data *ud)
                 OOM_ABORT;
         t = sscanf(ud->data, "%s %n%c", ctx_msg, &ctx_len, &dummy);
         status_msg = ud->data + ctx_len;
-        if (eql(ud->action, "push"))
+        if (ud->act == ACT_PUSH)
                 gtk_statusbar_push(statusbar,
                                    gtk_statusbar_get_context_id(statusbar, "0"),
                                    ud->data);
-        else if (eql(ud->action, "push_id") && t >= 1)
+        else if (ud->act == ACT_PUSH_ID && t >= 1)
                 gtk_statusbar_push(statusbar,
                                    gtk_statusbar_get_context_id(statusbar, ctx_msg),
                                    status_msg);
-        else if (eql(ud->action, "pop") && t < 1)
+        else if (ud->act == ACT_POP && t < 1)
                 gtk_statusbar_pop(statusbar,
                                   gtk_statusbar_get_context_id(statusbar, "0"));
-        else if (eql(ud->action, "pop_id") && t == 1)
+        else if (ud->act == ACT_POP_ID && t == 1)
                 gtk_statusbar_pop(statusbar,
                                   gtk_statusbar_get_context_id(statusbar, ctx_msg));
-        else if (eql(ud->action, "remove_all") && t < 1)
+        else if (ud->act == ACT_REMOVE_ALL && t < 1)
                 gtk_statusbar_remove_all(statusbar,
                                          gtk_statusbar_get_context_id(statusbar, "0"));
-        else if (eql(ud->action, "remove_all_id") && t == 1)
+        else if (ud->act == ACT_REMOVE_ALL_ID && t == 1)
                 gtk_statusbar_remove_all(statusbar,
                                          gtk_statusbar_get_context_id(statusbar, ctx_msg));
         else
@@ -2452,7 +4827,7 @@ update_switch(struct ui_data *ud)
         char dummy;
         unsigned int val;
 
-        if (eql(ud->action, "set_active") &&
+        if (ud->act == ACT_SET_ACTIVE &&
             sscanf(ud->data, "%u %c", &val, &dummy) == 1 && val < 2)
                 gtk_switch_set_active(GTK_SWITCH(ud->obj), val);
         else
@@ -2469,29 +4844,29 @@ update_text_view(struct ui_data *ud)
         char dummy;
         int val;
 
-        if (eql(ud->action, "set_text"))
+        if (ud->act == ACT_SET_TEXT)
                 gtk_text_buffer_set_text(textbuf, ud->data, -1);
-        else if (eql(ud->action, "delete") && sscanf(ud->data, " %c", &dummy) < 1) {
+        else if (ud->act == ACT_DELETE && sscanf(ud->data, " %c", &dummy) < 1) {
                 gtk_text_buffer_get_bounds(textbuf, &a, &b);
                 gtk_text_buffer_delete(textbuf, &a, &b);
-        } else if (eql(ud->action, "insert_at_cursor"))
+        } else if (ud->act == ACT_INSERT_AT_CURSOR)
                 gtk_text_buffer_insert_at_cursor(textbuf, ud->data, -1);
-        else if (eql(ud->action, "place_cursor") && eql(ud->data, "end")) {
+        else if (ud->act == ACT_PLACE_CURSOR && eql(ud->data, "end")) {
                 gtk_text_buffer_get_end_iter(textbuf, &a);
                 gtk_text_buffer_place_cursor(textbuf, &a);
-        } else if (eql(ud->action, "place_cursor") &&
+        } else if (ud->act == ACT_PLACE_CURSOR &&
                    sscanf(ud->data, "%d %c", &val, &dummy) == 1) {
                 gtk_text_buffer_get_iter_at_offset(textbuf, &a, val);
                 gtk_text_buffer_place_cursor(textbuf, &a);
-        } else if (eql(ud->action, "place_cursor_at_line") &&
+        } else if (ud->act == ACT_PLACE_CURSOR_AT_LINE &&
                    sscanf(ud->data, "%d %c", &val, &dummy) == 1) {
                 gtk_text_buffer_get_iter_at_line(textbuf, &a, val);
                 gtk_text_buffer_place_cursor(textbuf, &a);
-        } else if (eql(ud->action, "scroll_to_cursor") &&
+        } else if (ud->act == ACT_SCROLL_TO_CURSOR &&
                    sscanf(ud->data, " %c", &dummy) < 1)
                 gtk_text_view_scroll_to_mark(view, gtk_text_buffer_get_insert(textbuf),
                                              0., 0, 0., 0.);
-        else if (eql(ud->action, "save") && ud->data != NULL &&
+        else if (ud->act == ACT_SAVE && ud->data != NULL &&
                  (sv = fopen(ud->data, "w")) != NULL) {
                 gtk_text_buffer_get_bounds(textbuf, &a, &b);
                 send_msg(sv, GTK_BUILDABLE(view), "insert_at_cursor",
@@ -2507,9 +4882,9 @@ update_toggle_button(struct ui_data *ud)
         char dummy;
         unsigned int val;
 
-        if (eql(ud->action, "set_label"))
+        if (ud->act == ACT_SET_LABEL)
                 gtk_button_set_label(GTK_BUTTON(ud->obj), ud->data);
-        else if (eql(ud->action, "set_active") &&
+        else if (ud->act == ACT_SET_ACTIVE &&
                  sscanf(ud->data, "%u %c", &val, &dummy) == 1 && val < 2)
                 gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(ud->obj), val);
         else
@@ -2643,7 +5018,8 @@ create_subtree(GtkTreeModel *model, GtkTreePath *path, GtkTreeIter *iter)
 
 static bool
 set_tree_view_cell(GtkTreeModel *model, GtkTreeIter *iter,
-                   const char *path_s, int col, const char *new_text)
+                   const char *path_s, int col, const char *new_text,
+                   const char *bin)
 {
         GType col_type = gtk_tree_model_get_column_type(model, col);
         GtkTreePath *path;
@@ -2661,21 +5037,25 @@ set_tree_view_cell(GtkTreeModel *model, GtkTreeIter *iter,
         case G_TYPE_UINT:
         case G_TYPE_ULONG:
         case G_TYPE_UINT64:
-                if (new_text != NULL &&
-                    sscanf(new_text, "%lld %c", &n, &dummy) == 1) {
-                        create_subtree(model, path, iter);
-                        tree_model_set(model, iter, col, n, -1);
-                        ok = true;
-                }
+                if (bin != NULL && new_text == NULL)
+                        memcpy(&n, bin, sizeof(n));
+                else if (new_text == NULL ||
+                         sscanf(new_text, "%lld %c", &n, &dummy) != 1)
+                        break;
+                create_subtree(model, path, iter);
+                tree_model_set(model, iter, col, n, -1);
+                ok = true;
                 break;
         case G_TYPE_FLOAT:
         case G_TYPE_DOUBLE:
-                if (new_text != NULL &&
-                    sscanf(new_text, "%lf %c", &d, &dummy) == 1) {
-                        create_subtree(model, path, iter);
-                        tree_model_set(model, iter, col, d, -1);
-                        ok = true;
-                }
+                if (bin != NULL && new_text == NULL)
+                        memcpy(&d, bin, sizeof(d));
+                else if (new_text == NULL ||
+                         sscanf(new_text, "%lf %c", &d, &dummy) != 1)
+                        break;
+                create_subtree(model, path, iter);
+                tree_model_set(model, iter, col, d, -1);
+                ok = true;
                 break;
         case G_TYPE_STRING:
                 create_subtree(model, path, iter);
@@ -2733,61 +5113,62 @@ update_tree_view(struct ui_data *ud)
                 gtk_tree_model_get_iter_from_string(model, &iter1, arg1);
         if (is_path_string(arg1))
                 col = strtol(arg1, NULL, 10);
-        if (eql(ud->action, "set") &&
+        if (ud->act == ACT_SET &&
             col > -1 &&
             col < gtk_tree_model_get_n_columns(model) &&
             is_path_string(arg0)) {
-                if (set_tree_view_cell(model, &iter0, arg0, col, arg2) == false)
+                if (set_tree_view_cell(model, &iter0, arg0, col, arg2,
+                                       ud->bin_len == 8 ? ud->bin : NULL) == false)
                         ign_cmd(ud->type, ud->cmd);
-        } else if (eql(ud->action, "scroll") && iter0_valid && iter1_valid &&
+        } else if (ud->act == ACT_SCROLL && iter0_valid && iter1_valid &&
                    arg2 == NULL) {
                 path = gtk_tree_path_new_from_string(arg0);
                 gtk_tree_view_scroll_to_cell (view,
                                               path,
                                               gtk_tree_view_get_column(view, col),
                                               0, 0., 0.);
-        } else if (eql(ud->action, "expand") && iter0_valid && arg1 == NULL) {
+        } else if (ud->act == ACT_EXPAND && iter0_valid && arg1 == NULL) {
                 path = gtk_tree_path_new_from_string(arg0);
                 gtk_tree_view_expand_row(view, path, false);
-        } else if (eql(ud->action, "expand_all") && iter0_valid && arg1 == NULL) {
+        } else if (ud->act == ACT_EXPAND_ALL && iter0_valid && arg1 == NULL) {
                 path = gtk_tree_path_new_from_string(arg0);
                 gtk_tree_view_expand_row(view, path, true);
-        } else if (eql(ud->action, "expand_all") && arg0 == NULL)
+        } else if (ud->act == ACT_EXPAND_ALL && arg0 == NULL)
                 gtk_tree_view_expand_all(view);
-        else if (eql(ud->action, "collapse") && iter0_valid && arg1 == NULL) {
+        else if (ud->act == ACT_COLLAPSE && iter0_valid && arg1 == NULL) {
                 path = gtk_tree_path_new_from_string(arg0);
                 gtk_tree_view_collapse_row(view, path);
-        } else if (eql(ud->action, "collapse") && arg0 == NULL)
+        } else if (ud->act == ACT_COLLAPSE && arg0 == NULL)
                 gtk_tree_view_collapse_all(view);
-        else if (eql(ud->action, "set_cursor") && iter0_valid && arg1 == NULL) {
+        else if (ud->act == ACT_SET_CURSOR && iter0_valid && arg1 == NULL) {
                 path = gtk_tree_path_new_from_string(arg0);
                 tree_view_set_cursor(view, path, NULL);
-        } else if (eql(ud->action, "set_cursor") && arg0 == NULL) {
+        } else if (ud->act == ACT_SET_CURSOR && arg0 == NULL) {
                 tree_view_set_cursor(view, NULL, NULL);
                 gtk_tree_selection_unselect_all(sel);
-        } else if (eql(ud->action, "insert_row") &&
+        } else if (ud->act == ACT_INSERT_ROW &&
                    eql(arg0, "end") && arg1 == NULL)
                 tree_model_insert_before(model, &iter1, NULL, NULL);
-        else if (eql(ud->action, "insert_row") && iter0_valid &&
+        else if (ud->act == ACT_INSERT_ROW && iter0_valid &&
                  eql(arg1, "as_child") && arg2 == NULL)
                 tree_model_insert_after(model, &iter1, &iter0, NULL);
-        else if (eql(ud->action, "insert_row") && iter0_valid && arg1 == NULL)
+        else if (ud->act == ACT_INSERT_ROW && iter0_valid && arg1 == NULL)
                 tree_model_insert_before(model, &iter1, NULL, &iter0);
-        else if (eql(ud->action, "move_row") && iter0_valid &&
+        else if (ud->act == ACT_MOVE_ROW && iter0_valid &&
                  eql(arg1, "end") && arg2 == NULL)
                 tree_model_move_before(model, &iter0, NULL);
-        else if (eql(ud->action, "move_row") && iter0_valid && iter1_valid && arg2 == NULL)
+        else if (ud->act == ACT_MOVE_ROW && iter0_valid && iter1_valid && arg2 == NULL)
                 tree_model_move_before(model, &iter0, &iter1);
-        else if (eql(ud->action, "remove_row") && iter0_valid && arg1 == NULL)
+        else if (ud->act == ACT_REMOVE_ROW && iter0_valid && arg1 == NULL)
                 tree_model_remove(model, &iter0);
-        else if (eql(ud->action, "clear") && arg0 == NULL) {
+        else if (ud->act == ACT_CLEAR && arg0 == NULL) {
                 tree_view_set_cursor(view, NULL, NULL);
                 gtk_tree_selection_unselect_all(sel);
                 tree_model_clear(model);
-        } else if (eql(ud->action, "block") && arg0 != NULL) {
+        } else if (ud->act == ACT_BLOCK && arg0 != NULL) {
                 ud->obj=G_OBJECT(sel);
                 update_blocked(ud);
-        } else if (eql(ud->action, "save") && arg0 != NULL &&
+        } else if (ud->act == ACT_SAVE && arg0 != NULL &&
                    (ar.fout = fopen(arg0, "w")) != NULL) {
                 ar.obj = ud->obj;
                 gtk_tree_model_foreach(model,
@@ -2832,309 +5213,1257 @@ complain(struct ui_data *ud)
 
 /*
  * Parse command pointed to by ud, and act on ui accordingly.  Runs
- * once per command inside gtk_main().
+ * once per command inside gtk_main(), with LC_NUMERIC set to "C".
  */
 static gboolean
 update_ui(struct ui_data *ud)
 {
-        char *lc = lc_numeric();
-
         (ud->fn)(ud);
-        free(ud->cmd_tokens);
-        free(ud->cmd);
-        free(ud);
-        lc_numeric_free(lc);
         return G_SOURCE_REMOVE;
 }
 
 /*
- * Keep track of loading files to avoid recursive loading of the same
- * file.  If filename = NULL, forget the most recently remembered file.
+ * Execute command ud.  Should it be complained about, fall back to
+ * the command it superseded (option -C), which nothing else has
+ * touched the widget since.  Runs inside gtk_main().
  */
-static bool
-remember_loading_file(char *filename)
+static void
+exec_cmd(struct ui_data *ud)
 {
-        static char *filenames[BUFLEN];
-        static size_t latest = 0;
-        size_t i;
+        unsigned long long int before;
 
-        if (filename == NULL) {  /* pop */
-                if (latest < 1)
-                        ABORT;
-                latest--;
-                return false;
-        } else {                /* push */
-                for (i = 1; i <= latest; i++)
-                        if (eql(filename, filenames[i]))
-                                return false;
-                if (latest > BUFLEN -2)
-                        return false;
-                filenames[++latest] = filename;
-                return true;
+        for (; ud != NULL; ud = ud->supersedes) {
+                before = ignored;
+                update_ui(ud);
+                if (ignored == before)
+                        break;
         }
 }
 
 /*
- * Read lines from stream cmd and perform appropriate actions on the
- * GUI.  Runs inside receiver thread.
+ * Commands on their way from the receiver thread into the GTK main
+ * loop.  A single drain_queue() source, scheduled whenever the queue
+ * becomes non-empty, executes them in batches.
  */
-static void *
-digest_cmd(struct info *ar)
+static struct {
+        pthread_mutex_t lock;
+        pthread_cond_t not_full;
+        struct ui_data *cmds[QUEUE_LEN];
+        size_t head;            /* index of the oldest waiting command */
+        size_t depth;           /* number of waiting commands */
+        bool draining;          /* drain_queue() is scheduled */
+        struct ui_data *spare;  /* executed records, ready for reuse */
+        GHashTable *latest;     /* last waiting command per widget (-C) */
+        GtkWidget *paced_by;    /* toplevel whose frames drive draining (-F) */
+        GdkFrameClock *clock;   /* frame clock of paced_by we listen to */
+        guint watchdog;         /* source draining anyway if no frame */
+                                /* comes within FRAME_WAIT ms (-F) */
+        int nesting;            /* drain_queue() calls in progress; */
+                                /* used inside gtk_main() only */
+        /* statistics */
+        size_t peak_depth;
+        size_t max_batch;
+        unsigned long long int queued;
+        unsigned long long int batches;
+        unsigned long long int over_budget;
+        unsigned long long int full_waits;
+        unsigned long long int allocs;
+        unsigned long long int coalesced;
+} queue = {
+        .lock = PTHREAD_MUTEX_INITIALIZER,
+        .not_full = PTHREAD_COND_INITIALIZER,
+};
+
+static void
+unlock_queue(void *unused)
+{
+        (void) unused;
+        pthread_mutex_unlock(&queue.lock);
+}
+
+/*
+ * Execute waiting commands until either the queue is empty or
+ * DRAIN_BUDGET microseconds are used up.  In the latter case, stay
+ * scheduled and let the main loop handle other events first.  Runs
+ * inside gtk_main().
+ */
+static gboolean
+drain_queue(void *unused)
 {
-        static int recursion = -1; /* > 0 means this is a recursive call */
+        char *lc = lc_numeric();
+        struct timespec start;
+        struct ui_data *ud = NULL;
+        size_t batch = 0;
 
-        recursion++;
+        (void) unused;
+        queue.nesting++;
+        clock_gettime(CLOCK_MONOTONIC, &start);
         for (;;) {
-                FILE *cmd = ar->fin;
-                struct ui_data *ud = NULL;
-                char first_char = '\0';
-                char *id;       /* widget id */
-                size_t msg_size = 32;
-                int id_start = 0, id_end = 0;
-                int action_start = 0, action_end = 0;
-                int data_start = 0;
-
-                if (feof(cmd))
-                        break;
-                if ((ud = malloc(sizeof(*ud))) == NULL)
-                        OOM_ABORT;
-                if ((ud->cmd = malloc(msg_size)) == NULL)
-                        OOM_ABORT;
-                ud->args = ar;
-                ud->type = G_TYPE_INVALID;
-                pthread_testcancel();
-                if (recursion == 0)
-                        log_msg(ar->flog, NULL);
-                data_start = read_buf(cmd, &ud->cmd, &msg_size);
-                if (recursion == 0)
-                        log_msg(ar->flog, ud->cmd);
-                if ((ud->cmd_tokens = malloc(strlen(ud->cmd) + 1)) == NULL)
-                        OOM_ABORT;
-                sscanf(ud->cmd, " %c", &first_char);
-                if (data_start == 0 ||   /* empty line */
-                    first_char == '#') { /* comment */
-                        ud->fn = update_nothing;
-                        goto exec;
-                }
-                strcpy(ud->cmd_tokens, ud->cmd);
-                sscanf(ud->cmd_tokens,
-                       " %n%*[0-9a-zA-Z_-]%n:%n%*[0-9a-zA-Z_]%n%*1[ \t]%n",
-                       &id_start, &id_end, &action_start, &action_end, &data_start);
-                ud->cmd_tokens[id_end] = ud->cmd_tokens[action_end] = '\0';
-                id = ud->cmd_tokens + id_start;
-                ud->action = ud->cmd_tokens + action_start;
-                ud->data = ud->cmd_tokens + data_start;
-                if (eql(ud->action, "main_quit")) {
-                        ud->fn = main_quit;
-                        goto exec;
-                }
-                if (eql(ud->action, "load") && strlen(ud->data) > 0 &&
-                    remember_loading_file(ud->data)) {
-                        struct info a = *ar;
-
-                        if ((a.fin = fopen(ud->data, "r")) != NULL) {
-                                digest_cmd(&a);
-                                fclose(a.fin);
-                                ud->fn = update_nothing;
-                        } else
-                                ud->fn = complain;
-                        remember_loading_file(NULL);
-                        goto exec;
-                }
-                if ((ud->obj = (gtk_builder_get_object(ar->builder, id))) == NULL) {
-                        ud->fn = complain;
-                        goto exec;
+                pthread_mutex_lock(&queue.lock);
+                /* A superseded record goes back with its successor */
+                if (ud != NULL && ud->superseded)
+                        ud = NULL;
+                for (; ud != NULL; ud = ud->supersedes) {
+                        if (ud->staged != NULL) {
+                                *ud->staged_end = queue.spare;
+                                queue.spare = ud->staged;
+                        }
+                        ud->next = queue.spare;
+                        queue.spare = ud;
                 }
-                ud->type = G_TYPE_FROM_INSTANCE(ud->obj);
-                if (ud->type == GTK_TYPE_DRAWING_AREA)
-                        ud->fn = update_drawing_area;
-                else if (ud->type == GTK_TYPE_TREE_VIEW)
-                        ud->fn = update_tree_view;
-                else if (ud->type == GTK_TYPE_COMBO_BOX_TEXT)
-                        ud->fn = update_combo_box_text;
-                else if (ud->type == GTK_TYPE_LABEL)
-                        ud->fn = update_label;
-                else if (ud->type == GTK_TYPE_IMAGE)
-                        ud->fn = update_image;
-                else if (ud->type == GTK_TYPE_TEXT_VIEW)
-                        ud->fn = update_text_view;
-                else if (ud->type == GTK_TYPE_NOTEBOOK)
-                        ud->fn = update_notebook;
-                else if (ud->type == GTK_TYPE_EXPANDER)
-                        ud->fn = update_expander;
-                else if (ud->type == GTK_TYPE_FRAME ||
-                         ud->type == GTK_TYPE_ASPECT_FRAME)
-                        ud->fn = update_frame;
-                else if (ud->type == GTK_TYPE_SCROLLED_WINDOW)
-                        ud->fn = update_scrolled_window;
-                else if (ud->type == GTK_TYPE_LINK_BUTTON)
-                        ud->fn = update_link_button;
-                else if (ud->type == GTK_TYPE_BUTTON)
-                        ud->fn = update_button;
-                else if (ud->type == GTK_TYPE_MENU)
-                        ud->fn = update_menu;
-                else if (ud->type == GTK_TYPE_MENU_ITEM)
-                        ud->fn = update_menu_item;
-                else if (ud->type == GTK_TYPE_FILE_CHOOSER_DIALOG)
-                        ud->fn = update_file_chooser_dialog;
-                else if (ud->type == GTK_TYPE_FILE_CHOOSER_BUTTON)
-                        ud->fn = update_file_chooser_button;
-                else if (ud->type == GTK_TYPE_COLOR_BUTTON)
-                        ud->fn = update_color_button;
-                else if (ud->type == GTK_TYPE_FONT_BUTTON)
-                        ud->fn = update_font_button;
-                else if (ud->type == GTK_TYPE_PRINT_UNIX_DIALOG)
-                        ud->fn = update_print_dialog;
-                else if (ud->type == GTK_TYPE_SWITCH)
-                        ud->fn = update_switch;
-                else if (ud->type == GTK_TYPE_TOGGLE_BUTTON ||
-                         ud->type == GTK_TYPE_RADIO_BUTTON ||
-                         ud->type == GTK_TYPE_CHECK_BUTTON)
-                        ud->fn = update_toggle_button;
-                else if (ud->type == GTK_TYPE_ENTRY)
-                        ud->fn = update_entry;
-                else if (ud->type == GTK_TYPE_SPIN_BUTTON)
-                        ud->fn = update_spin_button;
-                else if (ud->type == GTK_TYPE_SCALE)
-                        ud->fn = update_scale;
-                else if (ud->type == GTK_TYPE_PROGRESS_BAR)
-                        ud->fn = update_progress_bar;
-                else if (ud->type == GTK_TYPE_SPINNER)
-                        ud->fn = update_spinner;
-                else if (ud->type == GTK_TYPE_STATUSBAR)
-                        ud->fn = update_statusbar;
-                else if (ud->type == GTK_TYPE_CALENDAR)
-                        ud->fn = update_calendar;
-                else if (ud->type == GTK_TYPE_SOCKET)
-                        ud->fn = update_socket;
-                else if (ud->type == GTK_TYPE_WINDOW ||
-                         ud->type == GTK_TYPE_DIALOG)
-                        ud->fn = update_window;
-                else
-                        ud->fn = try_generic_cmds;
-        exec:
-                pthread_testcancel();
-                gdk_threads_add_timeout(0, (GSourceFunc) update_ui, ud);
+                if (queue.depth == 0 ||
+                    (batch > 0 && usec_since(&start) > DRAIN_BUDGET))
+                        break;
+                ud = queue.cmds[queue.head];
+                queue.head = (queue.head + 1) % QUEUE_LEN;
+                if (queue.depth-- == QUEUE_LEN)
+                        pthread_cond_signal(&queue.not_full);
+                if (queue.latest != NULL &&
+                    g_hash_table_lookup(queue.latest, ud) == ud)
+                        g_hash_table_remove(queue.latest, ud);
+                pthread_mutex_unlock(&queue.lock);
+                if (!ud->superseded)
+                        exec_cmd(ud);
+                batch++;
         }
-        recursion--;
-        return NULL;
+        queue.batches++;
+        if (batch > queue.max_batch)
+                queue.max_batch = batch;
+        if (queue.depth > 0) {
+                queue.over_budget++;
+                pthread_mutex_unlock(&queue.lock);
+                lc_numeric_free(lc);
+                queue.nesting--;
+                return G_SOURCE_CONTINUE;
+        }
+        queue.draining = false;
+        pthread_mutex_unlock(&queue.lock);
+        lc_numeric_free(lc);
+        queue.nesting--;
+        return G_SOURCE_REMOVE;
 }
 
-
 /*
- * ============================================================
- *  Initialization
- * ============================================================
+ * Have fn called from the main loop as soon as it is idle, also from
+ * inside main loops of its own that commands like print run.  Runs
+ * inside any thread.
  */
+static void
+schedule_drain(GSourceFunc fn)
+{
+        GSource *source;
+
+        source = g_idle_source_new();
+        g_source_set_priority(source, G_PRIORITY_DEFAULT_IDLE);
+        g_source_set_can_recurse(source, TRUE);
+        g_source_set_callback(source, fn, NULL, NULL);
+        g_source_attach(source, NULL);
+        g_source_unref(source);
+}
 
 /*
- * Return the first string xpath obtains from ui_file.
- * xmlFree(string) must be called when done
+ * With option -F, drain the queue without waiting any longer for a
+ * frame that doesn't come, as when the toplevel window got hidden or
+ * unmapped after the frame was requested.  Runs inside gtk_main().
  */
-static xmlChar *
-xpath1(xmlChar *xpath, const char *ui_file)
+static gboolean
+frame_overdue(void *unused)
 {
-        xmlChar *r = NULL;
-        xmlDocPtr doc = NULL;
-        xmlNodeSetPtr nodes = NULL;
-        xmlXPathContextPtr ctx = NULL;
-        xmlXPathObjectPtr xpath_obj = NULL;
-
-        if ((doc = xmlParseFile(ui_file)) == NULL)
-                goto ret0;
-        if ((ctx = xmlXPathNewContext(doc)) == NULL)
-                goto ret1;
-        if ((xpath_obj = xmlXPathEvalExpression(xpath, ctx)) == NULL)
-                goto ret2;
-        if ((nodes = xpath_obj->nodesetval) != NULL && nodes->nodeNr > 0)
-                r = xmlNodeGetContent(nodes->nodeTab[0]);
-        xmlXPathFreeObject(xpath_obj);
-ret2:
-        xmlXPathFreeContext(ctx);
-ret1:
-        xmlFreeDoc(doc);
-ret0:
-        return r;
+        bool waiting;
+
+        (void) unused;
+        queue.watchdog = 0;
+        pthread_mutex_lock(&queue.lock);
+        waiting = queue.draining;
+        pthread_mutex_unlock(&queue.lock);
+        if (waiting)
+                schedule_drain(drain_queue);
+        return G_SOURCE_REMOVE;
 }
 
 /*
- * Attach key "col_number" to renderer.  Associate "col_number" with
- * the corresponding column number in the underlying model.
- * Due to what looks like a gap in the GTK API, renderer id and column
- * number are taken directly from the XML .ui file.
+ * Ask clock for a frame to drain the queue in, and make sure the
+ * queue gets drained even if the frame doesn't come.  Runs inside
+ * gtk_main().
  */
-static bool
-tree_view_column_get_renderer_column(GtkBuilder *builder, const char *ui_file,
-                                     GtkTreeViewColumn *t_col, int n,
-                                     GtkCellRenderer **rnd)
+static void
+request_frame(GdkFrameClock *clock)
 {
-        bool r = false;
-        char *xp_bas1 = "//object[@class=\"GtkTreeViewColumn\" and @id=\"";
-        char *xp_bas2 = "\"]/child[";
-        char *xp_bas3 = "]/object[@class=\"GtkCellRendererText\""
-                " or @class=\"GtkCellRendererToggle\"]/";
-        char *xp_rnd_id = "@id";
-        char *xp_text_col = "../attributes/attribute[@name=\"text\""
-                " or @name=\"active\"]/text()";
-        const char *tree_col_id = widget_id(GTK_BUILDABLE(t_col));
-        size_t xp_rnd_nam_len, xp_mod_col_len;
-        size_t xp_n_len = 3;    /* Big Enough (TM) */
-        xmlChar *xp_rnd_nam = NULL, *xp_mod_col = NULL;
-        xmlChar *rnd_nam = NULL, *mod_col = NULL;
-
-        /* find name of nth cell renderer under the GtkTreeViewColumn */
-        /* tree_col_id */
-        xp_rnd_nam_len = strlen(xp_bas1) + strlen(tree_col_id) +
-                strlen(xp_bas2) + xp_n_len + strlen(xp_bas3) +
-                strlen(xp_rnd_id) + sizeof('\0');
-        if ((xp_rnd_nam = malloc(xp_rnd_nam_len)) == NULL)
-                OOM_ABORT;
-        snprintf((char *) xp_rnd_nam, xp_rnd_nam_len, "%s%s%s%d%s%s",
-                 xp_bas1, tree_col_id, xp_bas2, n,
-                 xp_bas3, xp_rnd_id);
-        rnd_nam = xpath1(xp_rnd_nam, ui_file);
-        /* find the model column that is attached to the nth cell */
-        /* renderer under GtkTreeViewColumn tree_col_id */
-        xp_mod_col_len = strlen(xp_bas1) + strlen(tree_col_id) +
-                strlen(xp_bas2) + xp_n_len + strlen(xp_bas3) +
-                strlen(xp_text_col) + sizeof('\0');
-        if ((xp_mod_col = malloc(xp_mod_col_len)) == NULL)
-                OOM_ABORT;
-        snprintf((char *) xp_mod_col, xp_mod_col_len, "%s%s%s%d%s%s",
-                 xp_bas1, tree_col_id, xp_bas2, n, xp_bas3, xp_text_col);
-        mod_col = xpath1(xp_mod_col, ui_file);
-        if (rnd_nam) {
-                *rnd = GTK_CELL_RENDERER(
-                        gtk_builder_get_object(builder, (char *) rnd_nam));
-                if (mod_col) {
-                        g_object_set_data(G_OBJECT(*rnd), "col_number",
-                                          GINT_TO_POINTER(strtol((char *) mod_col,
-                                                                 NULL, 10)));
-                        r = true;
-                }
-        }
-        free(xp_rnd_nam);
-        free(xp_mod_col);
-        xmlFree(rnd_nam);
-        xmlFree(mod_col);
-        return r;
+        gdk_frame_clock_request_phase(clock, GDK_FRAME_CLOCK_PHASE_BEFORE_PAINT);
+        if (queue.watchdog == 0)
+                queue.watchdog = g_timeout_add(FRAME_WAIT, frame_overdue,
+                                               NULL);
 }
 
 /*
- * Callbacks that forward a modification of a tree view cell to the
- * underlying model
+ * With option -F, drain the queue while a frame is being prepared so
+ * that all its commands take effect in the same paint; drawing areas
+ * get refreshed right away instead of from a later idle source.  Runs
+ * inside gtk_main().
  */
 static void
-cb_tree_model_edit(GtkCellRenderer *renderer, const gchar *path_s,
-                   const gchar *new_text, struct info *ar)
+cb_before_paint(GdkFrameClock *clock, void *unused)
 {
-        GtkTreeIter iter;
-        int col = GPOINTER_TO_INT(g_object_get_data(G_OBJECT(renderer),
-                                                    "col_number"));
+        GHashTable *outer = deferred_redraws;
+        bool waiting, more;
+
+        (void) unused;
+        pthread_mutex_lock(&queue.lock);
+        waiting = queue.draining;
+        pthread_mutex_unlock(&queue.lock);
+        if (!waiting)
+                return;
+        if (queue.watchdog != 0) {
+                g_source_remove(queue.watchdog);
+                queue.watchdog = 0;
+        }
+        deferred_redraws = g_hash_table_new(g_direct_hash, g_direct_equal);
+        more = drain_queue(NULL) == G_SOURCE_CONTINUE;
+        refresh_deferred(outer);
+        if (more)
+                request_frame(clock);
+}
 
-        gtk_tree_model_get_iter_from_string(ar->model, &iter, path_s);
-        set_tree_view_cell(ar->model, &iter, path_s, col,
-                           new_text);
+/*
+ * Have waiting commands executed: right away, or, with option -F, at
+ * the next frame of the toplevel window, or after FRAME_WAIT ms if
+ * there is none by then.  Commands can't wait for a frame while the
+ * window is unmapped or while a command like print runs a main loop
+ * of its own.  Runs inside gtk_main().
+ */
+static gboolean
+start_drain(void *unused)
+{
+        GdkFrameClock *clock;
+
+        (void) unused;
+        if (queue.paced_by == NULL || queue.nesting > 0 ||
+            !gtk_widget_get_mapped(queue.paced_by) ||
+            (clock = gtk_widget_get_frame_clock(queue.paced_by)) == NULL)
+                return drain_queue(NULL);
+        if (clock != queue.clock) {
+                g_signal_connect(clock, "before-paint",
+                                 G_CALLBACK(cb_before_paint), NULL);
+                queue.clock = clock;
+        }
+        request_frame(clock);
+        return G_SOURCE_REMOVE;
+}
+
+/*
+ * Return a command record, preferably a recycled one.  Runs inside
+ * receiver thread.
+ */
+static struct ui_data *
+new_cmd(void)
+{
+        struct ui_data *ud;
+
+        pthread_mutex_lock(&queue.lock);
+        if ((ud = queue.spare) != NULL)
+                queue.spare = ud->next;
+        else
+                queue.allocs += 2;
+        pthread_mutex_unlock(&queue.lock);
+        if (ud != NULL)
+                return ud;
+        if ((ud = malloc(sizeof(*ud))) == NULL)
+                OOM_ABORT;
+        ud->cmd_size = 32;
+        if ((ud->cmd = malloc(ud->cmd_size)) == NULL)
+                OOM_ABORT;
+        return ud;
+}
+
+/*
+ * Read the next command line or frame into ud->cmd, followed by room
+ * ud->id for a copy of the widget id; return the length of the
+ * command text.  Anything in a frame after a '\0' goes to ud->bin.
+ * Runs inside receiver thread.
+ */
+static size_t
+read_cmd(struct reader *r, struct ui_data *ud)
+{
+        size_t len, n, old_size = ud->cmd_size;
+
+        if (r->framed) {
+                n = read_frame(r, &ud->cmd, &ud->cmd_size);
+                len = strlen(ud->cmd);
+        } else
+                n = len = read_buf(r, &ud->cmd, &ud->cmd_size);
+        if (2 * n + 2 > ud->cmd_size) {
+                while (2 * n + 2 > ud->cmd_size)
+                        ud->cmd_size *= 2;
+                if ((ud->cmd = realloc(ud->cmd, ud->cmd_size)) == NULL)
+                        OOM_ABORT;
+        }
+        if (ud->cmd_size != old_size) {
+                pthread_mutex_lock(&queue.lock);
+                queue.allocs++;
+                pthread_mutex_unlock(&queue.lock);
+        }
+        ud->bin = len + 1 < n ? ud->cmd + len + 1 : NULL;
+        ud->bin_len = len + 1 < n ? n - len - 1 : 0;
+        ud->id = ud->cmd + n + 1;
+        return len;
+}
+
+/*
+ * True for actions whose effect depends on nothing but their own
+ * data, which makes them redundant when followed by another one of
+ * the same kind on the same widget
+ */
+static bool
+is_idempotent(enum action act)
+{
+        switch (act) {
+        case ACT_SET_ACTIVE:
+        case ACT_SET_COLOR:
+        case ACT_SET_CURRENT_PAGE:
+        case ACT_SET_EXPANDED:
+        case ACT_SET_FILL_LEVEL:
+        case ACT_SET_FONT_NAME:
+        case ACT_SET_FRACTION:
+        case ACT_SET_INCREMENTS:
+        case ACT_SET_LABEL:
+        case ACT_SET_PLACEHOLDER_TEXT:
+        case ACT_SET_RANGE:
+        case ACT_SET_SENSITIVE:
+        case ACT_SET_SIZE_REQUEST:
+        case ACT_SET_TEXT:
+        case ACT_SET_TITLE:
+        case ACT_SET_TOOLTIP_TEXT:
+        case ACT_SET_VALUE:
+        case ACT_SET_VISIBLE:
+                return true;
+        default:
+                return false;
+        }
+}
+
+/*
+ * Hash and equality functions for queue.latest, which holds waiting
+ * commands keyed by their widget
+ */
+static guint
+cmd_target_hash(gconstpointer a)
+{
+        const struct ui_data *ud = a;
+
+        return g_direct_hash(ud->obj);
+}
+
+static gboolean
+cmd_target_equal(gconstpointer a, gconstpointer b)
+{
+        const struct ui_data *ua = a, *ub = b;
+
+        return ua->obj == ub->obj;
+}
+
+/*
+ * With option -C, let idempotent action ud supersede the last waiting
+ * command to the same widget if that is the same action; any other
+ * command to the widget in between keeps both.  Commands staged by a
+ * transaction count as being in between, too.  Runs inside receiver
+ * thread with queue.lock held.
+ */
+static void
+coalesce_cmd(struct ui_data *ud)
+{
+        struct ui_data *prev, *s;
+
+        if (queue.latest == NULL)
+                return;
+        for (s = ud->staged; s != NULL; s = s->next)
+                if (s->obj != NULL)
+                        g_hash_table_remove(queue.latest, s);
+        if (ud->obj == NULL)
+                return;
+        prev = g_hash_table_lookup(queue.latest, ud);
+        if (prev != NULL && prev->act == ud->act && is_idempotent(ud->act)) {
+                prev->superseded = true;
+                ud->supersedes = prev;
+                queue.coalesced++;
+        }
+        /* Replaces prev, key included */
+        g_hash_table_add(queue.latest, ud);
+}
+
+/*
+ * Hand command ud over to the GTK main loop, waiting while the queue
+ * is full.  Runs inside receiver thread.
+ */
+static void
+enqueue_cmd(struct ui_data *ud)
+{
+        bool schedule = false;
+
+        pthread_mutex_lock(&queue.lock);
+        pthread_cleanup_push(unlock_queue, NULL);
+        if (queue.depth == QUEUE_LEN)
+                queue.full_waits++;
+        while (queue.depth == QUEUE_LEN)
+                pthread_cond_wait(&queue.not_full, &queue.lock);
+        coalesce_cmd(ud);
+        queue.cmds[(queue.head + queue.depth++) % QUEUE_LEN] = ud;
+        queue.queued++;
+        if (queue.depth > queue.peak_depth)
+                queue.peak_depth = queue.depth;
+        if (!queue.draining)
+                schedule = queue.draining = true;
+        pthread_cleanup_pop(1);
+        if (schedule)
+                schedule_drain(start_drain);
+}
+
+/*
+ * Report the state of the command queue.  Runs inside gtk_main().
+ */
+static void
+send_stats(struct ui_data *ud)
+{
+        char str[2 * BUFLEN];
+
+        pthread_mutex_lock(&queue.lock);
+        snprintf(str, sizeof(str),
+                 "depth=%zu peak_depth=%zu queued=%llu batches=%llu "
+                 "max_batch=%zu over_budget=%llu full_waits=%llu allocs=%llu "
+                 "coalesced=%llu",
+                 queue.depth, queue.peak_depth, queue.queued, queue.batches,
+                 queue.max_batch, queue.over_budget, queue.full_waits,
+                 queue.allocs, queue.coalesced);
+        pthread_mutex_unlock(&queue.lock);
+        route_reply(ud);
+        send_msg_by_id(ud->args->fout, ud->id, "stats", str, NULL);
+}
+
+/*
+ * Execute the commands staged between begin and commit, refreshing
+ * each drawing area involved just once, at the end; report the time
+ * it took.  Runs inside gtk_main().
+ */
+static void
+commit_txn(struct ui_data *ud)
+{
+        GHashTable *outer = deferred_redraws;
+        struct timespec start;
+        struct ui_data *c;
+        char str[BUFLEN];
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        deferred_redraws = g_hash_table_new(g_direct_hash, g_direct_equal);
+        for (c = ud->staged; c != NULL; c = c->next)
+                update_ui(c);
+        refresh_deferred(outer);
+        snprintf(str, BUFLEN, "%ld", usec_since(&start));
+        route_reply(ud);
+        send_msg_by_id(ud->args->fout, ud->id, "committed", str, NULL);
+}
+
+/*
+ * Keep track of loading files to avoid recursive loading of the same
+ * file.  If filename = NULL, forget the most recently remembered file.
+ */
+static bool
+remember_loading_file(char *filename)
+{
+        static char *filenames[BUFLEN];
+        static size_t latest = 0;
+        size_t i;
+
+        if (filename == NULL) {  /* pop */
+                if (latest < 1)
+                        ABORT;
+                latest--;
+                return false;
+        } else {                /* push */
+                for (i = 1; i <= latest; i++)
+                        if (eql(filename, filenames[i]))
+                                return false;
+                if (latest > BUFLEN -2)
+                        return false;
+                filenames[++latest] = filename;
+                return true;
+        }
+}
+
+/*
+ * Return the function that updates widgets of the given type
+ */
+static void
+(*updater(GType type))(struct ui_data *)
+{
+        if (type == GTK_TYPE_DRAWING_AREA)
+                return update_drawing_area;
+        else if (type == GTK_TYPE_TREE_VIEW)
+                return update_tree_view;
+        else if (type == GTK_TYPE_COMBO_BOX_TEXT)
+                return update_combo_box_text;
+        else if (type == GTK_TYPE_LABEL)
+                return update_label;
+        else if (type == GTK_TYPE_IMAGE)
+                return update_image;
+        else if (type == GTK_TYPE_TEXT_VIEW)
+                return update_text_view;
+        else if (type == GTK_TYPE_NOTEBOOK)
+                return update_notebook;
+        else if (type == GTK_TYPE_EXPANDER)
+                return update_expander;
+        else if (type == GTK_TYPE_FRAME ||
+                 type == GTK_TYPE_ASPECT_FRAME)
+                return update_frame;
+        else if (type == GTK_TYPE_SCROLLED_WINDOW)
+                return update_scrolled_window;
+        else if (type == GTK_TYPE_LINK_BUTTON)
+                return update_link_button;
+        else if (type == GTK_TYPE_BUTTON)
+                return update_button;
+        else if (type == GTK_TYPE_MENU)
+                return update_menu;
+        else if (type == GTK_TYPE_MENU_ITEM)
+                return update_menu_item;
+        else if (type == GTK_TYPE_FILE_CHOOSER_DIALOG)
+                return update_file_chooser_dialog;
+        else if (type == GTK_TYPE_FILE_CHOOSER_BUTTON)
+                return update_file_chooser_button;
+        else if (type == GTK_TYPE_COLOR_BUTTON)
+                return update_color_button;
+        else if (type == GTK_TYPE_FONT_BUTTON)
+                return update_font_button;
+        else if (type == GTK_TYPE_PRINT_UNIX_DIALOG)
+                return update_print_dialog;
+        else if (type == GTK_TYPE_SWITCH)
+                return update_switch;
+        else if (type == GTK_TYPE_TOGGLE_BUTTON ||
+                 type == GTK_TYPE_RADIO_BUTTON ||
+                 type == GTK_TYPE_CHECK_BUTTON)
+                return update_toggle_button;
+        else if (type == GTK_TYPE_ENTRY)
+                return update_entry;
+        else if (type == GTK_TYPE_SPIN_BUTTON)
+                return update_spin_button;
+        else if (type == GTK_TYPE_SCALE)
+                return update_scale;
+        else if (type == GTK_TYPE_PROGRESS_BAR)
+                return update_progress_bar;
+        else if (type == GTK_TYPE_SPINNER)
+                return update_spinner;
+        else if (type == GTK_TYPE_STATUSBAR)
+                return update_statusbar;
+        else if (type == GTK_TYPE_CALENDAR)
+                return update_calendar;
+        else if (type == GTK_TYPE_SOCKET)
+                return update_socket;
+        else if (type == GTK_TYPE_WINDOW ||
+                 type == GTK_TYPE_DIALOG)
+                return update_window;
+        else
+                return try_generic_cmds;
+}
+
+/*
+ * What digest_cmd() needs to know about a widget
+ */
+struct widget_entry {
+        GObject *obj;
+        GType type;
+        void (*fn)(struct ui_data *);
+};
+
+/*
+ * Add obj to index widgets under the name id
+ */
+static struct widget_entry *
+index_widget(GHashTable *widgets, const char *id, GObject *obj)
+{
+        struct widget_entry *w;
+
+        if ((w = malloc(sizeof(*w))) == NULL)
+                OOM_ABORT;
+        w->obj = obj;
+        w->type = G_TYPE_FROM_INSTANCE(obj);
+        w->fn = updater(w->type);
+        g_hash_table_insert(widgets, g_strdup(id), w);
+        return w;
+}
+
+/*
+ * Look up the widget named id.  Objects the builder has acquired after
+ * the index was made are added on first use.  Runs inside receiver
+ * thread.
+ */
+static struct widget_entry *
+find_widget(struct info *ar, const char *id)
+{
+        GObject *obj;
+        struct widget_entry *w;
+
+        if ((w = g_hash_table_lookup(ar->widgets, id)) != NULL)
+                return w;
+        if ((obj = gtk_builder_get_object(ar->builder, id)) == NULL)
+                return NULL;
+        return index_widget(ar->widgets, id, obj);
+}
+
+/*
+ * Clients connected to the socket of option -s.  The receiver thread
+ * accepts them and reads their commands; the forwarder thread sends
+ * them feedback.
+ */
+struct client {
+        struct reader rd;
+        GHashTable *subs;       /* ids of widgets whose feedback is */
+                                /* wanted; NULL: all widgets */
+        bool gone;              /* failed to take feedback */
+        unsigned long long int serial; /* unique number, never 0 */
+        int refs;               /* from server.clients and from the */
+                                /* forwarder thread while sending */
+};
+
+static struct {
+        pthread_mutex_t lock;   /* protects clients and their members */
+        struct client *clients[MAX_CLIENTS];
+        size_t n_clients;
+        int listen_fd;
+        int feedback_fd;        /* read end of the pipe behind ar->fout */
+        unsigned long long int serials; /* given to clients so far */
+        bool framed;            /* option -B */
+} server = {
+        .lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+static void
+unlock_server(void *unused)
+{
+        (void) unused;
+        pthread_mutex_unlock(&server.lock);
+}
+
+/*
+ * Drop a reference to client c, closing its connection and freeing it
+ * along with the last one.  Runs with server.lock held.
+ */
+static void
+unref_client(struct client *c)
+{
+        if (--c->refs > 0)
+                return;
+        close(c->rd.fd);
+        reader_free(&c->rd);
+        if (c->subs != NULL)
+                g_hash_table_destroy(c->subs);
+        free(c);
+}
+
+/*
+ * Start (on = true) or stop sending feedback from widget id to client
+ * c.  A client that never subscribed to anything gets all feedback.
+ * Runs inside receiver thread.
+ */
+static void
+subscribe(struct client *c, const char *id, bool on)
+{
+        pthread_mutex_lock(&server.lock);
+        if (on && c->subs == NULL)
+                c->subs = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                                g_free, NULL);
+        if (on)
+                g_hash_table_add(c->subs, g_strdup(id));
+        else if (c->subs != NULL)
+                g_hash_table_remove(c->subs, id);
+        pthread_mutex_unlock(&server.lock);
+}
+
+/*
+ * Give up on a transaction that is never going to be committed or
+ * that has grown beyond MAX_TXN_LEN commands: complain about its
+ * begin command and discard the rest.  Runs inside receiver thread.
+ */
+static void
+abandon_txn(struct reader *rd)
+{
+        struct ui_data *ud = rd->txn;
+
+        ud->fn = complain;
+        ud->staged = ud->next;
+        ud->staged_end = rd->txn_end;
+        rd->txn = NULL;
+        enqueue_cmd(ud);
+}
+
+/*
+ * Depth of nested :load commands; used inside receiver thread only
+ */
+static int loading = 0;
+
+/*
+ * Read the next command from reader rd and queue it for execution on
+ * the GUI.  Runs inside receiver thread.
+ */
+static void
+digest_one(struct info *ar, struct reader *rd)
+{
+        struct ui_data *ud = NULL;
+        struct widget_entry *w;
+        char c, first_char = '\0';
+        char *id;       /* widget id */
+        size_t len;
+        int id_start = 0, id_end = 0;
+        int action_start = 0, action_end = 0;
+        int data_start = 0;
+
+        ud = new_cmd();
+        ud->args = ar;
+        ud->obj = NULL;
+        ud->type = G_TYPE_INVALID;
+        ud->act = ACT_NONE;
+        ud->superseded = false;
+        ud->supersedes = NULL;
+        ud->client = rd->client == NULL ? 0 : rd->client->serial;
+        ud->staged = NULL;
+        pthread_testcancel();
+        if (loading == 0)
+                log_msg(ar->flog, NULL);
+        data_start = len = read_cmd(rd, ud);
+        if (loading == 0)
+                log_msg(ar->flog, ud->cmd);
+        sscanf(ud->cmd, " %c", &first_char);
+        if (data_start == 0 ||   /* empty line */
+            first_char == '#') { /* comment */
+                ud->fn = update_nothing;
+                goto exec;
+        }
+        sscanf(ud->cmd,
+               " %n%*[0-9a-zA-Z_-]%n:%n%*[0-9a-zA-Z_]%n%*1[ \t]%n",
+               &id_start, &id_end, &action_start, &action_end, &data_start);
+        /* Keep ud->cmd intact for error messages; the id */
+        /* goes into the space behind it.  Like the original */
+        /* tokenizer, leave the id empty when no action follows */
+        /* it, so that such a line is complained about as a */
+        /* whole rather than ignored by its widget. */
+        if (id_end < id_start || action_end == id_start)
+                id_end = id_start;
+        id = ud->id;
+        memcpy(id, ud->cmd + id_start, id_end - id_start);
+        id[id_end - id_start] = '\0';
+        c = ud->cmd[action_end];
+        ud->cmd[action_end] = '\0';
+        ud->act = action_id(ud->cmd + action_start);
+        ud->cmd[action_end] = c;
+        ud->data = ud->cmd + data_start;
+        if (ud->act == ACT_MAIN_QUIT) {
+                ud->fn = main_quit;
+                goto exec;
+        }
+        if (ud->act == ACT_STATS) {
+                ud->fn = *ud->data == '\0' ? send_stats : complain;
+                goto exec;
+        }
+        if (ud->act == ACT_STYLESHEET) {
+                ud->fn = *ud->data == '\0' ? complain : update_stylesheet;
+                goto exec;
+        }
+        if (ud->act == ACT_BEGIN && *ud->data == '\0' && rd->txn == NULL) {
+                ud->fn = update_nothing;
+                ud->next = NULL;
+                rd->txn = ud;
+                rd->txn_end = &ud->next;
+                rd->txn_len = 0;
+                return;
+        }
+        if (ud->act == ACT_COMMIT && *ud->data == '\0' && rd->txn != NULL) {
+                ud->fn = commit_txn;
+                ud->staged = rd->txn;
+                ud->staged_end = rd->txn_end;
+                rd->txn = NULL;
+                goto exec;
+        }
+        if (ud->act == ACT_BEGIN || ud->act == ACT_COMMIT) {
+                ud->fn = complain;
+                goto exec;
+        }
+        if (ud->act == ACT_SUBSCRIBE || ud->act == ACT_UNSUBSCRIBE) {
+                if (*ud->data == '\0' && rd->client != NULL) {
+                        subscribe(rd->client, id, ud->act == ACT_SUBSCRIBE);
+                        ud->fn = update_nothing;
+                } else
+                        ud->fn = complain;
+                goto exec;
+        }
+        if (ud->act == ACT_LOAD && strlen(ud->data) > 0 &&
+            remember_loading_file(ud->data)) {
+                FILE *f;
+                struct reader lrd;
+
+                if ((f = fopen(ud->data, "r")) != NULL) {
+                        /* Carry an open transaction into the file */
+                        /* and back */
+                        reader_init(&lrd, fileno(f), false);
+                        lrd.client = rd->client;
+                        lrd.txn = rd->txn;
+                        lrd.txn_end = rd->txn_end;
+                        lrd.txn_len = rd->txn_len;
+                        loading++;
+                        while (!lrd.eof)
+                                digest_one(ar, &lrd);
+                        loading--;
+                        rd->txn = lrd.txn;
+                        rd->txn_end = lrd.txn_end;
+                        rd->txn_len = lrd.txn_len;
+                        reader_free(&lrd);
+                        fclose(f);
+                        ud->fn = update_nothing;
+                } else
+                        ud->fn = complain;
+                remember_loading_file(NULL);
+                goto exec;
+        }
+        if ((w = find_widget(ar, id)) == NULL) {
+                ud->fn = complain;
+                goto exec;
+        }
+        ud->obj = w->obj;
+        ud->type = w->type;
+        ud->fn = w->fn;
+exec:
+        pthread_testcancel();
+        if (rd->txn != NULL) {
+                ud->next = NULL;
+                *rd->txn_end = ud;
+                rd->txn_end = &ud->next;
+                if (++rd->txn_len > MAX_TXN_LEN)
+                        abandon_txn(rd);
+        } else
+                enqueue_cmd(ud);
+}
+
+/*
+ * Read lines from stream ar->fin and perform appropriate actions on
+ * the GUI.  Runs inside receiver thread.
+ */
+static void *
+digest_cmd(struct info *ar)
+{
+        struct reader rd;
+
+        reader_init(&rd, fileno(ar->fin), ar->fin == framed_in);
+        while (!rd.eof)
+                digest_one(ar, &rd);
+        if (rd.txn != NULL)
+                abandon_txn(&rd);
+        reader_free(&rd);
+        return NULL;
+}
+
+/*
+ * Accept a new client of the socket.  Runs inside receiver thread.
+ */
+static void
+accept_client(void)
+{
+        struct client *c;
+        struct timeval timeout = {1, 0};
+        int fd;
+
+        if ((fd = accept(server.listen_fd, NULL, NULL)) < 0)
+                return;
+        if (server.n_clients == MAX_CLIENTS) {
+                fprintf(stderr, "too many clients; closing connection\n");
+                close(fd);
+                return;
+        }
+        setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+        if ((c = malloc(sizeof(*c))) == NULL)
+                OOM_ABORT;
+        reader_init(&c->rd, fd, server.framed);
+        c->rd.client = c;
+        c->subs = NULL;
+        c->gone = false;
+        c->serial = ++server.serials;
+        c->refs = 1;
+        pthread_mutex_lock(&server.lock);
+        server.clients[server.n_clients++] = c;
+        pthread_mutex_unlock(&server.lock);
+}
+
+/*
+ * Forget socket client number i, moving the last client into its
+ * place.  Runs inside receiver thread.
+ */
+static void
+drop_client(size_t i)
+{
+        struct client *c = server.clients[i];
+
+        if (c->rd.txn != NULL)
+                abandon_txn(&c->rd);
+        pthread_mutex_lock(&server.lock);
+        server.clients[i] = server.clients[--server.n_clients];
+        unref_client(c);
+        pthread_mutex_unlock(&server.lock);
+}
+
+/*
+ * Accept socket clients and perform the actions their commands ask
+ * for, in whatever order the commands arrive.  A client's commands
+ * are executed in sequence.  Runs inside receiver thread.
+ */
+static void *
+serve(struct info *ar)
+{
+        struct client *c;
+        struct pollfd fds[MAX_CLIENTS + 1];
+        size_t i, n;
+
+        for (;;) {
+                fds[0].fd = server.listen_fd;
+                fds[0].events = POLLIN;
+                for (n = 0; n < server.n_clients; n++) {
+                        fds[n + 1].fd = server.clients[n]->rd.fd;
+                        fds[n + 1].events = POLLIN;
+                }
+                if (poll(fds, n + 1, -1) < 0) {
+                        if (errno == EINTR)
+                                continue;
+                        fprintf(stderr, "polling socket clients: %s\n",
+                                strerror(errno));
+                        break;
+                }
+                /* Back to front; drop_client() moves the last one */
+                for (i = n; i-- > 0;) {
+                        if (fds[i + 1].revents == 0)
+                                continue;
+                        c = server.clients[i];
+                        feed_reader(&c->rd);
+                        while (reader_ready(&c->rd) ||
+                               (c->rd.eof && c->rd.pos < c->rd.len))
+                                digest_one(ar, &c->rd);
+                        if (c->rd.eof)
+                                drop_client(i);
+                }
+                if (fds[0].revents & POLLIN)
+                        accept_client();
+        }
+        return NULL;
+}
+
+/*
+ * Store the next feedback message from reader r, including its
+ * newline or frame header, into buf, which should have been malloc'd
+ * to bufsize.  Enlarge buf and bufsize if necessary.  Return the
+ * message length; 0 means end of file.
+ */
+static size_t
+read_msg(struct reader *r, char **buf, size_t *bufsize)
+{
+        unsigned char *h;
+        char *nl = NULL;
+        size_t n = 0, k;
+
+        if (r->framed) {
+                if (!read_bytes(r, *buf, 4))
+                        return 0;
+                h = (unsigned char *) *buf;
+                n = (size_t) h[0] << 24 | (size_t) h[1] << 16 |
+                        (size_t) h[2] << 8 | (size_t) h[3];
+                while (n + 4 > *bufsize)
+                        if ((*buf = realloc(*buf, *bufsize *= 2)) == NULL)
+                                OOM_ABORT;
+                return read_bytes(r, *buf + 4, n) ? n + 4 : 0;
+        }
+        while (nl == NULL) {
+                if (r->pos >= r->len && !fill_reader(r))
+                        break;
+                k = r->len - r->pos;
+                if ((nl = memchr(r->buf + r->pos, '\n', k)) != NULL)
+                        k = nl - (r->buf + r->pos) + 1;
+                while (n + k > *bufsize)
+                        if ((*buf = realloc(*buf, *bufsize *= 2)) == NULL)
+                                OOM_ABORT;
+                memcpy(*buf + n, r->buf + r->pos, k);
+                r->pos += k;
+                n += k;
+        }
+        return n;
+}
+
+/*
+ * Send msg of length len to client c, or disconnect c and return false
+ * if it fails to take it within a second.  Runs inside forwarder
+ * thread, holding a reference to c but not server.lock.
+ */
+static bool
+send_to_client(struct client *c, const char *msg, size_t len)
+{
+        ssize_t n;
+
+        while (len > 0) {
+                if ((n = send(c->rd.fd, msg, len, MSG_NOSIGNAL)) < 0) {
+                        if (errno == EINTR)
+                                continue;
+                        fprintf(stderr, "send error; disconnecting client\n");
+                        shutdown(c->rd.fd, SHUT_RDWR);
+                        return false;
+                }
+                msg += n;
+                len -= n;
+        }
+        return true;
+}
+
+/*
+ * Pass feedback messages on to the socket clients that want them.  A
+ * message whose id is "\001<serial>" announces that the next one is a
+ * reply for client number serial alone.  The clients are picked under
+ * server.lock but sent to without it, so that a slow client holds up
+ * neither the receiver thread nor, for longer than it takes to time
+ * out, the other clients.  Runs inside forwarder thread.
+ */
+static void *
+forward_feedback(void *unused)
+{
+        struct reader r;
+        struct client *c, *to[MAX_CLIENTS];
+        bool ok[MAX_CLIENTS];
+        char *msg, *colon;
+        size_t i, n, len, start, size = BUFLEN;
+        unsigned long long int reply_to = 0;
+
+        (void) unused;
+        reader_init(&r, server.feedback_fd, server.framed);
+        if ((msg = malloc(size)) == NULL)
+                OOM_ABORT;
+        start = server.framed ? 4 : 0;
+        while ((len = read_msg(&r, &msg, &size)) > 0) {
+                if ((colon = memchr(msg + start, ':', len - start)) == NULL)
+                        continue;
+                *colon = '\0';
+                if (msg[start] == '\001') {
+                        reply_to = strtoull(msg + start + 1, NULL, 10);
+                        continue;
+                }
+                n = 0;
+                pthread_mutex_lock(&server.lock);
+                pthread_cleanup_push(unlock_server, NULL);
+                for (i = 0; i < server.n_clients; i++) {
+                        c = server.clients[i];
+                        if (!c->gone &&
+                            (reply_to != 0 ? c->serial == reply_to :
+                             c->subs == NULL ||
+                             g_hash_table_contains(c->subs, msg + start))) {
+                                c->refs++;
+                                to[n++] = c;
+                        }
+                }
+                *colon = ':';
+                reply_to = 0;
+                pthread_cleanup_pop(1);
+                for (i = 0; i < n; i++)
+                        ok[i] = send_to_client(to[i], msg, len);
+                pthread_mutex_lock(&server.lock);
+                pthread_cleanup_push(unlock_server, NULL);
+                for (i = 0; i < n; i++) {
+                        if (!ok[i])
+                                to[i]->gone = true;
+                        unref_client(to[i]);
+                }
+                pthread_cleanup_pop(1);
+        }
+        free(msg);
+        reader_free(&r);
+        return NULL;
+}
+
+
+/*
+ * ============================================================
+ *  Initialization
+ * ============================================================
+ */
+
+/*
+ * A cell renderer of a GtkTreeViewColumn and the model column it
+ * shows
+ */
+struct cell_column {
+        char *renderer;         /* id */
+        int col;
+};
+
+static void
+free_cell_column(struct cell_column *cc)
+{
+        if (cc == NULL)
+                return;
+        g_free(cc->renderer);
+        free(cc);
+}
+
+/*
+ * Whether XML element node has an attribute name whose value is one
+ * of the NULL-terminated arguments following name
+ */
+static bool
+has_prop(xmlNodePtr node, const char *name, ...)
+{
+        bool r = false;
+        const char *value;
+        xmlChar *prop;
+        va_list ap;
+
+        if ((prop = xmlGetProp(node, (const xmlChar *) name)) == NULL)
+                return false;
+        va_start(ap, name);
+        while (!r && (value = va_arg(ap, const char *)) != NULL)
+                r = xmlStrEqual(prop, (const xmlChar *) value);
+        va_end(ap);
+        xmlFree(prop);
+        return r;
+}
+
+/*
+ * The first child element of node called name, starting the search
+ * at child (or at the first child of node if child is NULL)
+ */
+static xmlNodePtr
+xml_child(xmlNodePtr node, xmlNodePtr child, const char *name)
+{
+        for (child = child == NULL ? node->children : child->next;
+             child != NULL; child = child->next)
+                if (child->type == XML_ELEMENT_NODE &&
+                    xmlStrEqual(child->name, (const xmlChar *) name))
+                        return child;
+        return NULL;
+}
+
+/*
+ * Add to columns an array, indexed by position of the <child>
+ * elements of GtkTreeViewColumn node, of the text or toggle cell
+ * renderers and the model columns their "text" or "active" attribute
+ * is taken from; NULL where any of them is missing
+ */
+static void
+index_tree_view_column(GHashTable *columns, xmlNodePtr node, xmlChar *id)
+{
+        GPtrArray *cells;
+        struct cell_column *cc;
+        xmlChar *rnd_id, *mod_col;
+        xmlNodePtr child, obj, attrs, attr;
+
+        if (g_hash_table_contains(columns, id))
+                return;
+        cells = g_ptr_array_new_with_free_func((GDestroyNotify) free_cell_column);
+        for (child = xml_child(node, NULL, "child"); child != NULL;
+             child = xml_child(node, child, "child")) {
+                cc = NULL;
+                for (obj = xml_child(child, NULL, "object"); obj != NULL;
+                     obj = xml_child(child, obj, "object"))
+                        if (has_prop(obj, "class", "GtkCellRendererText",
+                                     "GtkCellRendererToggle", NULL))
+                                break;
+                for (attrs = xml_child(child, NULL, "attributes");
+                     obj != NULL && cc == NULL && attrs != NULL;
+                     attrs = xml_child(child, attrs, "attributes"))
+                        for (attr = xml_child(attrs, NULL, "attribute");
+                             attr != NULL; attr = xml_child(attrs, attr, "attribute"))
+                                if (has_prop(attr, "name", "text", "active", NULL)) {
+                                        if ((rnd_id = xmlGetProp(obj, (const xmlChar *) "id")) == NULL)
+                                                break;
+                                        if ((cc = malloc(sizeof(*cc))) == NULL)
+                                                OOM_ABORT;
+                                        mod_col = xmlNodeGetContent(attr);
+                                        cc->renderer = g_strdup((char *) rnd_id);
+                                        cc->col = strtol((char *) mod_col, NULL, 10);
+                                        xmlFree(mod_col);
+                                        xmlFree(rnd_id);
+                                        break;
+                                }
+                g_ptr_array_add(cells, cc);
+        }
+        g_hash_table_insert(columns, g_strdup((char *) id), cells);
+}
+
+/*
+ * Index the GtkTreeViewColumns among the siblings from node on, and
+ * among their descendants
+ */
+static void
+index_ui_nodes(GHashTable *columns, xmlNodePtr node)
+{
+        xmlChar *id;
+
+        for (; node != NULL; node = node->next) {
+                if (node->type != XML_ELEMENT_NODE)
+                        continue;
+                if (xmlStrEqual(node->name, (const xmlChar *) "object") &&
+                    has_prop(node, "class", "GtkTreeViewColumn", NULL) &&
+                    (id = xmlGetProp(node, (const xmlChar *) "id")) != NULL) {
+                        index_tree_view_column(columns, node, id);
+                        xmlFree(id);
+                }
+                index_ui_nodes(columns, node->children);
+        }
+}
+
+/*
+ * Read ui_file, which GtkBuilder has already accepted, once more and
+ * return an index of its GtkTreeViewColumns by id.  Due to what looks
+ * like a gap in the GTK API, renderer ids and model column numbers are
+ * taken directly from the XML.
+ */
+static GHashTable *
+index_tree_view_columns(const char *ui_file)
+{
+        GHashTable *columns;
+        xmlDocPtr doc;
+
+        columns = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                                        (GDestroyNotify) g_ptr_array_unref);
+        if ((doc = xmlParseFile(ui_file)) == NULL)
+                return columns;
+        index_ui_nodes(columns, xmlDocGetRootElement(doc));
+        xmlFreeDoc(doc);
+        return columns;
+}
+
+/*
+ * Attach key "col_number" to the nth renderer of t_col.  Associate
+ * "col_number" with the corresponding column number in the underlying
+ * model.
+ */
+static bool
+tree_view_column_get_renderer_column(GtkBuilder *builder, GHashTable *columns,
+                                     GtkTreeViewColumn *t_col, int n,
+                                     GtkCellRenderer **rnd)
+{
+        GPtrArray *cells;
+        struct cell_column *cc;
+
+        if ((cells = g_hash_table_lookup(columns, widget_id(GTK_BUILDABLE(t_col)))) == NULL ||
+            n < 1 || (unsigned int) n > cells->len ||
+            (cc = g_ptr_array_index(cells, n - 1)) == NULL)
+                return false;
+        *rnd = GTK_CELL_RENDERER(gtk_builder_get_object(builder, cc->renderer));
+        g_object_set_data(G_OBJECT(*rnd), "col_number", GINT_TO_POINTER(cc->col));
+        return true;
+}
+
+/*
+ * Callbacks that forward a modification of a tree view cell to the
+ * underlying model
+ */
+static void
+cb_tree_model_edit(GtkCellRenderer *renderer, const gchar *path_s,
+                   const gchar *new_text, struct info *ar)
+{
+        GtkTreeIter iter;
+        int col = GPOINTER_TO_INT(g_object_get_data(G_OBJECT(renderer),
+                                                    "col_number"));
+
+        gtk_tree_model_get_iter_from_string(ar->model, &iter, path_s);
+        set_tree_view_cell(ar->model, &iter, path_s, col,
+                           new_text, NULL);
         send_tree_cell_msg_by(send_msg, path_s, &iter, col, ar);
 }
 
@@ -3149,7 +6478,7 @@ cb_tree_model_toggle(GtkCellRenderer *renderer, gchar *path_s, struct info *ar)
         gtk_tree_model_get_iter_from_string(ar->model, &iter, path_s);
         gtk_tree_model_get(ar->model, &iter, col, &toggle_state, -1);
         set_tree_view_cell(ar->model, &iter, path_s, col,
-                           toggle_state? "0" : "1");
+                           toggle_state? "0" : "1", NULL);
 }
 
 /*
@@ -3215,7 +6544,7 @@ connect_widget_signals(gpointer *obj, struct info *ar)
                         GtkCellRenderer *renderer;
                         gboolean editable = FALSE;
 
-                        if (!tree_view_column_get_renderer_column(ar->builder, ar->txt, tv_col,
+                        if (!tree_view_column_get_renderer_column(ar->builder, ar->columns, tv_col,
                                                                   i, &renderer))
                                 continue;
                         if (GTK_IS_CELL_RENDERER_TEXT(renderer)) {
@@ -3360,55 +6689,432 @@ connect_widget_signals(gpointer *obj, struct info *ar)
 }
 
 /*
- * We keep a style provider with each widget
+ * Add obj to the index of widgets digest_cmd() consults
  */
 static void
-add_widget_style_provider(gpointer *obj, void *data)
+index_object(GObject *obj, GHashTable *widgets)
 {
-        GtkCssProvider *style_provider;
-        GtkStyleContext *context;
-
-        (void) data;
-        if (!GTK_IS_WIDGET(obj))
-                return;
-        style_provider = gtk_css_provider_new();
-        context = gtk_widget_get_style_context(GTK_WIDGET(obj));
-        gtk_style_context_add_provider(context,
-                                       GTK_STYLE_PROVIDER(style_provider),
-                                       GTK_STYLE_PROVIDER_PRIORITY_APPLICATION);
-        g_object_set_data(G_OBJECT(obj), "style_provider", style_provider);
+        if (GTK_IS_BUILDABLE(obj) && widget_id(GTK_BUILDABLE(obj)) != NULL)
+                index_widget(widgets, widget_id(GTK_BUILDABLE(obj)), obj);
 }
 
-static void
+/*
+ * Connect signals and return an index of all objects by their ids
+ */
+static GHashTable *
 prepare_widgets(GtkBuilder *builder, char *ui_file, FILE *out)
 {
+        GHashTable *widgets;
         GSList *objects = NULL;
-        struct info ar = {.builder = builder, .fout = out, .txt = ui_file};
+        struct info ar = {.builder = builder, .fout = out};
 
+        widgets = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, free);
         objects = gtk_builder_get_objects(builder);
-        g_slist_foreach(objects, (GFunc) connect_widget_signals, &ar);
-        g_slist_foreach(objects, (GFunc) add_widget_style_provider, NULL);
+        ar.columns = index_tree_view_columns(ui_file);
+        foreach_timed(objects, (GFunc) connect_widget_signals, &ar);
+        g_hash_table_unref(ar.columns);
+        g_slist_foreach(objects, (GFunc) index_object, widgets);
         g_slist_free(objects);
+        return widgets;
+}
+
+/*
+ * Zygote server (option -Z): a resident process that keeps a spare
+ * pipeglade instance ready, GTK initialized and theme loaded, and
+ * hands it over to the next client (option -z).  The zygote itself
+ * never opens the display, so no two processes share a connection to
+ * it.
+ *
+ * A client sends its stdin, stdout, and stderr along with a 32-bit
+ * length followed by that many bytes: its working directory, its umask
+ * in octal, its environment variables, an empty string, and its
+ * arguments, each terminated by '\0'.  The zygote passes the
+ * connection on to the spare and, once the instance has terminated,
+ * answers with its exit status as a single byte.
+ */
+#define MAX_REQUEST (1 << 20)
+
+extern char **environ;
+
+struct instance {
+        struct instance *next;
+        pid_t pid;
+        int conn;               /* to the client */
+};
+
+static int zygote_signals[2]; /* self-pipe */
+
+static void
+cb_zygote_signal(int sig)
+{
+        int e = errno;
+        char c = sig;
+
+        write(zygote_signals[1], &c, 1);
+        errno = e;
+}
+
+/*
+ * Send n file descriptors fds and len bytes from buf over socket s;
+ * return false on errors
+ */
+static bool
+send_fds(int s, const int *fds, int n, const void *buf, size_t len)
+{
+        char ctl[CMSG_SPACE(3 * sizeof(int))];
+        struct cmsghdr *cmsg;
+        struct iovec iov = {.iov_base = (void *) buf, .iov_len = len};
+        struct msghdr msg = {
+                .msg_iov = &iov,
+                .msg_iovlen = 1,
+                .msg_control = ctl,
+                .msg_controllen = CMSG_SPACE(n * sizeof(int)),
+        };
+
+        memset(ctl, 0, sizeof(ctl));
+        cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(n * sizeof(int));
+        memcpy(CMSG_DATA(cmsg), fds, n * sizeof(int));
+        return sendmsg(s, &msg, MSG_NOSIGNAL) == (ssize_t) len;
+}
+
+/*
+ * Read exactly len bytes from fd into buf; return false on errors or
+ * premature EOF
+ */
+static bool
+read_fully(int fd, void *buf, size_t len)
+{
+        ssize_t n;
+
+        while (len > 0) {
+                if ((n = read(fd, buf, len)) < 0 && errno == EINTR)
+                        continue;
+                if (n <= 0)
+                        return false;
+                buf = (char *) buf + n;
+                len -= n;
+        }
+        return true;
+}
+
+/*
+ * Receive exactly n file descriptors into fds and len bytes into buf
+ * from socket s; return false otherwise
+ */
+static bool
+recv_fds(int s, int *fds, int n, void *buf, size_t len)
+{
+        char ctl[CMSG_SPACE(3 * sizeof(int))];
+        int got = 0;
+        ssize_t r;
+        struct cmsghdr *cmsg;
+        struct iovec iov = {.iov_base = buf, .iov_len = len};
+        struct msghdr msg = {
+                .msg_iov = &iov,
+                .msg_iovlen = 1,
+                .msg_control = ctl,
+                .msg_controllen = sizeof(ctl),
+        };
+
+        if ((r = recvmsg(s, &msg, 0)) <= 0)
+                return false;
+        for (cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL;
+             cmsg = CMSG_NXTHDR(&msg, cmsg))
+                if (cmsg->cmsg_level == SOL_SOCKET &&
+                    cmsg->cmsg_type == SCM_RIGHTS) {
+                        got = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+                        memcpy(fds, CMSG_DATA(cmsg), got * sizeof(int));
+                }
+        return got == n && read_fully(s, (char *) buf + r, len - r);
+}
+
+/*
+ * Act as a spare instance: initialize GTK, wait for the zygote to pass
+ * a client connection over socket s, and take over the client's
+ * standard streams, working directory, umask, environment, locale, and
+ * arguments.  Whatever GTK took from the environment while
+ * initializing stays as it was.
+ */
+static void
+spare_instance(int s, int *argc, char ***argv)
+{
+        GtkWidget *w;
+        char c, *req, *p, *end, *vars, *args, **env;
+        int conn, fds[3], i, n = 1;
+        uint32_t len;
+
+        gtk_init(NULL, NULL);
+        /* Get theme and fonts loaded */
+        w = gtk_window_new(GTK_WINDOW_TOPLEVEL);
+        gtk_container_add(GTK_CONTAINER(w), gtk_button_new_with_label("pipeglade"));
+        gtk_widget_get_preferred_size(w, NULL, NULL);
+        gtk_widget_destroy(w);
+        if (!recv_fds(s, &conn, 1, &c, 1))
+                exit(EXIT_FAILURE);     /* zygote gone */
+        clock_gettime(CLOCK_MONOTONIC, &startup.start);
+        close(s);
+        if (!recv_fds(conn, fds, 3, &len, sizeof(len)) || len > MAX_REQUEST)
+                exit(EXIT_FAILURE);
+        if ((req = malloc(len + 1)) == NULL)
+                OOM_ABORT;
+        if (!read_fully(conn, req, len))
+                exit(EXIT_FAILURE);
+        req[len] = '\0';
+        close(conn);
+        for (i = 0; i < 3; i++) {
+                dup2(fds[i], i);
+                close(fds[i]);
+        }
+        end = req + len;
+        if (chdir(req) != 0)
+                bye(EXIT_FAILURE, stderr, "changing directory to %s: %s\n",
+                    req, strerror(errno));
+        if ((p = req + strlen(req) + 1) >= end)
+                exit(EXIT_FAILURE);
+        umask(strtol(p, NULL, 8));
+        /* Environment, up to the empty string; req is kept for good */
+        vars = p + strlen(p) + 1;
+        for (i = 0, p = vars; p < end && *p != '\0'; p += strlen(p) + 1)
+                i++;
+        if (p >= end)
+                exit(EXIT_FAILURE);
+        if ((env = malloc((i + 1) * sizeof(*env))) == NULL)
+                OOM_ABORT;
+        for (i = 0, p = vars; *p != '\0'; p += strlen(p) + 1)
+                env[i++] = p;
+        env[i] = NULL;
+        environ = env;
+        setlocale(LC_ALL, "");
+        args = p + 1;
+        for (p = args; p < end; p += strlen(p) + 1)
+                n++;
+        if ((*argv = malloc((n + 1) * sizeof(**argv))) == NULL)
+                OOM_ABORT;
+        (*argv)[0] = "pipeglade";
+        for (i = 1, p = args; i < n; p += strlen(p) + 1)
+                (*argv)[i++] = p;
+        (*argv)[n] = NULL;
+        *argc = n;
+}
+
+/*
+ * Fork a spare instance that is going to take the next connection
+ * passed over *to_spare.  Return its pid in the zygote and 0 in the
+ * spare once it has been handed a client.
+ */
+static pid_t
+fork_spare(int listen_fd, struct instance *instances, int *to_spare,
+           int *argc, char ***argv)
+{
+        int sp[2];
+        pid_t pid;
+
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, sp) < 0 || (pid = fork()) < 0)
+                bye(EXIT_FAILURE, stderr, "making spare instance: %s\n",
+                    strerror(errno));
+        if (pid > 0) {
+                close(sp[1]);
+                *to_spare = sp[0];
+                return pid;
+        }
+        signal(SIGCHLD, SIG_DFL);
+        signal(SIGINT, SIG_DFL);
+        signal(SIGTERM, SIG_DFL);
+        close(zygote_signals[0]);
+        close(zygote_signals[1]);
+        close(listen_fd);
+        close(sp[0]);
+        for (; instances != NULL; instances = instances->next)
+                close(instances->conn);
+        spare_instance(sp[1], argc, argv);
+        return 0;
+}
+
+/*
+ * Run the zygote server on socket name, with the UI definitions
+ * ui_files preloaded.  Return only inside an instance handed to a
+ * client, with that client's arguments in *argc and *argv.
+ */
+static void
+zygote_server(const char *name, char **ui_files, int *argc, char ***argv)
+{
+        char c, status;
+        int conn, listen_fd, to_spare, wstatus;
+        pid_t pid, spare;
+        struct instance *inst, **ip, *instances = NULL;
+        struct pollfd fds[2];
+        struct sigaction sa = {.sa_handler = cb_zygote_signal};
+
+        for (; *ui_files != NULL; ui_files++)
+                preload_ui_file(*ui_files);
+        listen_fd = open_socket(name);
+        if (pipe(zygote_signals) < 0)
+                bye(EXIT_FAILURE, stderr, "making pipe: %s\n", strerror(errno));
+        sigemptyset(&sa.sa_mask);
+        sigaction(SIGCHLD, &sa, NULL);
+        sigaction(SIGINT, &sa, NULL);
+        sigaction(SIGTERM, &sa, NULL);
+        if ((spare = fork_spare(listen_fd, instances, &to_spare, argc, argv)) == 0)
+                return;
+        for (;;) {
+                fds[0].fd = listen_fd;
+                fds[0].events = POLLIN;
+                fds[1].fd = zygote_signals[0];
+                fds[1].events = POLLIN;
+                if (poll(fds, 2, -1) < 0) {
+                        if (errno == EINTR)
+                                continue;
+                        bye(EXIT_FAILURE, stderr, "polling socket %s: %s\n",
+                            name, strerror(errno));
+                }
+                if (fds[1].revents & POLLIN && read(zygote_signals[0], &c, 1) == 1) {
+                        if (c == SIGINT || c == SIGTERM) {
+                                kill(spare, SIGTERM);
+                                remove(name);
+                                exit(EXIT_SUCCESS);
+                        }
+                        while ((pid = waitpid(-1, &wstatus, WNOHANG)) > 0) {
+                                if (pid == spare) {
+                                        remove(name);
+                                        bye(EXIT_FAILURE, stderr,
+                                            "spare instance failed\n");
+                                }
+                                for (ip = &instances; (inst = *ip) != NULL; ip = &inst->next)
+                                        if (inst->pid == pid) {
+                                                status = WIFEXITED(wstatus) ?
+                                                        WEXITSTATUS(wstatus) : EXIT_FAILURE;
+                                                send(inst->conn, &status, 1, MSG_NOSIGNAL);
+                                                close(inst->conn);
+                                                *ip = inst->next;
+                                                free(inst);
+                                                break;
+                                        }
+                        }
+                }
+                if (fds[0].revents & POLLIN &&
+                    (conn = accept(listen_fd, NULL, NULL)) >= 0) {
+                        if ((inst = malloc(sizeof(*inst))) == NULL)
+                                OOM_ABORT;
+                        send_fds(to_spare, &conn, 1, "", 1);
+                        close(to_spare);
+                        inst->pid = spare;
+                        inst->conn = conn;
+                        inst->next = instances;
+                        instances = inst;
+                        if ((spare = fork_spare(listen_fd, instances, &to_spare,
+                                                argc, argv)) == 0)
+                                return;
+                }
+        }
+}
+
+/*
+ * Have the zygote server on socket name run an instance with
+ * arguments args on our standard streams, and exit with its status
+ */
+static void
+zygote_client(const char *name, char **args)
+{
+        struct sockaddr_un sa = {.sun_family = AF_UNIX};
+        char *req, cwd[PATH_MAX], mask_s[16], status;
+        int fd, fds[3] = {0, 1, 2};
+        size_t len, pos;
+        uint32_t n;
+        mode_t mask;
+        char **a;
+
+        if (strlen(name) >= sizeof(sa.sun_path))
+                bye(EXIT_FAILURE, stderr, "socket name %s too long\n", name);
+        strcpy(sa.sun_path, name);
+        if (getcwd(cwd, sizeof(cwd)) == NULL)
+                bye(EXIT_FAILURE, stderr, "getting working directory: %s\n",
+                    strerror(errno));
+        mask = umask(0);
+        umask(mask);
+        snprintf(mask_s, sizeof(mask_s), "%o", (unsigned int) mask);
+        len = strlen(cwd) + 1 + strlen(mask_s) + 1 + 1;
+        for (a = environ; *a != NULL; a++)
+                len += strlen(*a) + 1;
+        for (a = args; *a != NULL; a++)
+                len += strlen(*a) + 1;
+        if (len > MAX_REQUEST)
+                bye(EXIT_FAILURE, stderr,
+                    "arguments and environment too long\n");
+        if ((req = malloc(len)) == NULL)
+                OOM_ABORT;
+        strcpy(req, cwd);
+        pos = strlen(cwd) + 1;
+        strcpy(req + pos, mask_s);
+        pos += strlen(mask_s) + 1;
+        for (a = environ; *a != NULL; a++) {
+                strcpy(req + pos, *a);
+                pos += strlen(*a) + 1;
+        }
+        req[pos++] = '\0';
+        for (a = args; *a != NULL; a++) {
+                strcpy(req + pos, *a);
+                pos += strlen(*a) + 1;
+        }
+        n = len;
+        if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0 ||
+            connect(fd, (struct sockaddr *) &sa, sizeof(sa)) < 0 ||
+            !send_fds(fd, fds, 3, &n, sizeof(n)) ||
+            send(fd, req, len, MSG_NOSIGNAL) != (ssize_t) len)
+                bye(EXIT_FAILURE, stderr, "connecting to %s: %s\n",
+                    name, strerror(errno));
+        free(req);
+        if (!read_fully(fd, &status, 1))
+                exit(EXIT_FAILURE);
+        exit((unsigned char) status);
+}
+
+/*
+ * Deal with options -Z and -z, which must come first
+ */
+static void
+zygote_if(int *argc, char ***argv)
+{
+        if (*argc < 2 || !(eql((*argv)[1], "-Z") || eql((*argv)[1], "-z")))
+                return;
+        if (*argc < 3)
+                bye(EXIT_FAILURE, stderr, USAGE);
+        if (eql((*argv)[1], "-z"))
+                zygote_client((*argv)[2], *argv + 3);
+        else
+                zygote_server((*argv)[2], *argv + 3, argc, argv);
 }
 
 int
 main(int argc, char *argv[])
 {
         GObject *main_window = NULL;
-        bool bg = false;
+        GtkWidget *toplevel;
+        bool bg = false, coalesce = false, framed = false, paced = false;
+        bool timed = false;
         char *in_fifo = NULL, *out_fifo = NULL;
         char *ui_file = "pipeglade.ui", *log_file = NULL, *err_file = NULL;
-        char *xid = NULL;
+        char *xid = NULL, *sock_name = NULL, *css_file = NULL;
         char opt;
-        pthread_t receiver;
+        pthread_t receiver, forwarder;
         struct info ar;
+        GError *error = NULL;
 
+        clock_gettime(CLOCK_MONOTONIC, &startup.start);
         /* Disable runtime GLIB deprecation warnings: */
         setenv("G_ENABLE_DIAGNOSTIC", "0", 0);
+        zygote_if(&argc, &argv);
         gtk_init(&argc, &argv);
-        while ((opt = getopt(argc, argv, "bGhe:i:l:o:O:u:V")) != -1) {
+        startup_mark("gtk_init");
+        while ((opt = getopt(argc, argv, "bBc:CFGhe:i:l:o:O:s:Tu:V")) != -1) {
                 switch (opt) {
                 case 'b': bg = true; break;
+                case 'B': framed = true; break;
+                case 'c': css_file = optarg; break;
+                case 'C': coalesce = true; break;
+                case 'F': paced = true; break;
                 case 'e': xid = optarg; break;
                 case 'G': show_lib_versions(); break;
                 case 'h': bye(EXIT_SUCCESS, stdout, USAGE); break;
@@ -3416,6 +7122,8 @@ main(int argc, char *argv[])
                 case 'l': log_file = optarg; break;
                 case 'o': out_fifo = optarg; break;
                 case 'O': err_file = optarg; break;
+                case 's': sock_name = optarg; break;
+                case 'T': timed = true; break;
                 case 'u': ui_file = optarg; break;
                 case 'V': bye(EXIT_SUCCESS, stdout, "%s\n", VERSION); break;
                 case '?':
@@ -3426,22 +7134,74 @@ main(int argc, char *argv[])
                 bye(EXIT_FAILURE, stderr,
                     "illegal parameter '%s'\n" USAGE, argv[optind]);
         redirect_stderr(err_file);
-        ar.fin = open_fifo(in_fifo, "r", stdin, _IONBF);
-        ar.fout = open_fifo(out_fifo, "w", stdout, _IOLBF);
+        if (sock_name == NULL) {
+                ar.fin = open_fifo(in_fifo, "r", stdin, _IONBF);
+                ar.fout = open_fifo(out_fifo, "w", stdout, _IOLBF);
+        } else {
+                int fds[2];
+
+                if (in_fifo != NULL || out_fifo != NULL)
+                        bye(EXIT_FAILURE, stderr,
+                            "parameter -s excludes -i and -o\n");
+                server.listen_fd = open_socket(sock_name);
+                server.framed = framed;
+                if (pipe(fds) < 0 || (ar.fout = fdopen(fds[1], "w")) == NULL)
+                        bye(EXIT_FAILURE, stderr, "making feedback pipe: %s\n",
+                            strerror(errno));
+                setvbuf(ar.fout, NULL, _IOLBF, 0);
+                server.feedback_fd = fds[0];
+                ar.fin = NULL;
+        }
         go_bg_if(bg, ar.fin, ar.fout, err_file);
+        startup_mark("open_io");
+        if (framed) {
+                framed_in = ar.fin;
+                framed_out = ar.fout;
+        }
+        if (coalesce)
+                queue.latest = g_hash_table_new(cmd_target_hash,
+                                                cmd_target_equal);
+        if (css_file != NULL && !load_stylesheet(css_file, &error))
+                bye(EXIT_FAILURE, stderr, "%s\n", error->message);
         ar.builder = builder_from_file(ui_file);
+        startup_mark("builder");
         ar.flog = open_log(log_file);
-        pthread_create(&receiver, NULL, (void *(*)(void *)) digest_cmd, &ar);
+        if (timed) {
+                startup.report = ar.flog == NULL ? stderr : ar.flog;
+                startup.types = g_hash_table_new_full(g_direct_hash,
+                                                      g_direct_equal,
+                                                      NULL, free);
+        }
         main_window = find_main_window(ar.builder);
         xmlInitParser();
         LIBXML_TEST_VERSION;
-        prepare_widgets(ar.builder, ui_file, ar.fout);
-        xembed_if(xid, main_window);
+        ar.widgets = prepare_widgets(ar.builder, ui_file, ar.fout);
+        startup_mark("prepare_widgets");
+        startup_report();
+        if (sock_name == NULL)
+                pthread_create(&receiver, NULL, (void *(*)(void *)) digest_cmd, &ar);
+        else {
+                pthread_create(&forwarder, NULL, forward_feedback, NULL);
+                pthread_create(&receiver, NULL, (void *(*)(void *)) serve, &ar);
+        }
+        toplevel = xembed_if(xid, main_window);
+        if (timed)
+                g_signal_connect_after(toplevel, "draw",
+                                       G_CALLBACK(cb_first_paint), NULL);
+        if (paced)
+                queue.paced_by = toplevel;
         gtk_main();
         pthread_cancel(receiver);
         pthread_join(receiver, NULL);
+        if (sock_name != NULL) {
+                pthread_cancel(forwarder);
+                pthread_join(forwarder, NULL);
+        }
         xmlCleanupParser();
-        rm_unless(stdin, ar.fin, in_fifo);
-        rm_unless(stdout, ar.fout, out_fifo);
+        if (sock_name == NULL) {
+                rm_unless(stdin, ar.fin, in_fifo);
+                rm_unless(stdout, ar.fout, out_fifo);
+        } else
+                remove(sock_name);
         exit(EXIT_SUCCESS);
 }
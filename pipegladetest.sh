@@ -29,6 +29,10 @@ EPSF_FILE=test.epsf
 PDF_FILE=test.pdf
 PS_FILE=test.ps
 SVG_FILE=test.svg
+CSS_FILE=test.css
+ZYGOTE_SOCKET=zygote.sock
+SOCKET=pipeglade.sock
+VERTEX_FILE=vertices.bin
 FILE1=saved1.txt
 FILE2=saved2.txt
 FILE3=saved3.txt
@@ -42,7 +46,8 @@ WEIRD_PATHS=$(awk 'BEGIN{ for (i=0x01; i<= 0xff; i++) if (i != 0x2a && i != 0x2f
 BIG_STRING=$(for i in {1..100}; do echo -n "abcdefghijklmnopqrstuvwxyz($i)ABCDEFGHIJKLMNOPQRSTUVWXYZ0{${RANDOM}}123456789"; done)
 BIG_NUM=$(for i in {1..100}; do echo -n "$RANDOM"; done)
 rm -rf $FIN $FOUT $FERR $LOG $ERR_FILE $BAD_FIFO $PID_FILE $OUT_FILE \
-   $EPS_FILE $EPSF_FILE $PDF_FILE $PS_FILE $SVG_FILE \
+   $EPS_FILE $EPSF_FILE $PDF_FILE $PS_FILE $SVG_FILE $CSS_FILE $ZYGOTE_SOCKET \
+   $SOCKET $VERTEX_FILE \
    $FILE1 $FILE2 $FILE3 $FILE4 $FILE5 $FILE6 $BIG_INPUT $BIG_INPUT2 $BIG_INPUT_ERR $DIR
 
 if stat -f "%0p" 2>/dev/null; then
@@ -157,6 +162,8 @@ if test $AUTOMATIC; then
                "no toplevel window with id 'main'" ""
     check_call "./pipeglade -u www-template/404.html" 1 \
                "html" ""
+    check_call "./pipeglade -c nonexistent.css" 1 \
+               "nonexistent.css" ""
     check_call "./pipeglade -u README" 1 \
                "Document must begin with an element" ""
     check_call "./pipeglade -e x" 1 \
@@ -187,8 +194,10 @@ if test $AUTOMATIC; then
                "parameter -b requires both -i and -o"
     rm $FIN $FOUT
     check_call "./pipeglade -h" 0 \
-               "" "usage: pipeglade [[-i in-fifo] [-o out-fifo] [-b] [-u glade-file.ui] [-e xid]
-                 [-l log-file] [-O err-file] [--display X-server]] | [-h|-G|-V]"
+               "" "usage: pipeglade [[-i in-fifo] [-o out-fifo] [-b] [-B] [-C] [-F] [-u glade-file.ui] [-c css-file]
+                 [-s socket] [-e xid] [-l log-file] [-T] [-O err-file] [--display X-server]] | [-h|-G|-V]
+       pipeglade -Z socket [glade-file.ui ...]
+       pipeglade -z socket [option ...]"
     check_call "./pipeglade -G" 0 \
                "" "GTK+  v"
     check_call "./pipeglade -G" 0 \
@@ -205,6 +214,18 @@ if test $AUTOMATIC; then
                "argument" ""
     check_call "./pipeglade -o" 1 \
                "argument" ""
+    check_call "./pipeglade -s" 1 \
+               "argument" ""
+    check_call "./pipeglade -s $FIN -o $FOUT" 1 \
+               "parameter -s excludes -i and -o" ""
+    check_call "./pipeglade -Z" 1 \
+               "usage" ""
+    check_call "./pipeglade -z" 1 \
+               "usage" ""
+    check_call "./pipeglade -z $ZYGOTE_SOCKET" 1 \
+               "connecting to $ZYGOTE_SOCKET" ""
+    check_call "./pipeglade -Z $ZYGOTE_SOCKET nonexistent.ui" 1 \
+               "preloading nonexistent.ui" ""
     mkdir -p $DIR
     check_call "./pipeglade -O" 1 \
                "argument" ""
@@ -272,6 +293,11 @@ if test $AUTOMATIC; then
                 "ignoring command \"nnn\""
     check_error "BIG_STRING" \
                 "ignoring command \"BIG_STRING\""
+    # Existing id without action
+    check_error "button1" \
+                "ignoring command \"button1\""
+    check_error "button1:" \
+                "ignoring command \"button1:\""
     check_error "nnn:set_text FFFF" \
                 "ignoring command \"nnn:set_text FFFF\""
     check_error "nnn:set_text $BIG_STRING" \
@@ -308,6 +334,10 @@ if test $AUTOMATIC; then
     check_error "|:main_quit" \
                 "ignoring command \"|:main_quit"
     # Wrong number or kind of arguments for generic actions
+    check_error "button1:add_class" \
+                "ignoring GtkButton command \"button1:add_class\""
+    check_error "button1:remove_class a b" \
+                "ignoring GtkButton command \"button1:remove_class a b\""
     check_error "button1:set_sensitive" \
                 "ignoring GtkButton command \"button1:set_sensitive\""
     check_error "button1:set_sensitive 2" \
@@ -338,6 +368,22 @@ if test $AUTOMATIC; then
                 "ignoring GtkButton command \"button1:force 2\""
     check_error "_:main_quit 2" \
                 "ignoring command \"_:main_quit 2\""
+    check_error "_:stats 2" \
+                "ignoring command \"_:stats 2\""
+    check_error "_:stylesheet" \
+                "ignoring command \"_:stylesheet\""
+    check_error "_:stylesheet nonexistent.css" \
+                "ignoring command \"_:stylesheet nonexistent.css\""
+    check_error "button1:subscribe" \
+                "ignoring command \"button1:subscribe\""
+    check_error "_:commit" \
+                "ignoring command \"_:commit\""
+    check_error "_:begin 2" \
+                "ignoring command \"_:begin 2\""
+    check_error "_:begin\n $(printf 'scale1:set_value 1\\n %.0s' {1..16385})_:commit" \
+                "ignoring command \"_:begin\""
+    check_error "" \
+                "ignoring command \"_:commit\""
     check_error "button1:block 2" \
                 "ignoring GtkButton command \"button1:block 2\""
     check_error "button1:block 0 0" \
@@ -1223,6 +1269,40 @@ if test $AUTOMATIC; then
                 "ignoring GtkDrawingArea command \"drawingarea1:line_to 1 20 nnn\""
     check_error "drawingarea1:line_to 1 20 20 20" \
                 "ignoring GtkDrawingArea command \"drawingarea1:line_to 1 20 20 20\""
+    check_error "drawingarea1:polyline 1" \
+                "ignoring GtkDrawingArea command \"drawingarea1:polyline 1\""
+    check_error "drawingarea1:polyline 1 20 20 20" \
+                "ignoring GtkDrawingArea command \"drawingarea1:polyline 1 20 20 20\""
+    check_error "drawingarea1:polyline 1 20 20 nnn" \
+                "ignoring GtkDrawingArea command \"drawingarea1:polyline 1 20 20 nnn\""
+    check_error "drawingarea1:polygon 1 20" \
+                "ignoring GtkDrawingArea command \"drawingarea1:polygon 1 20\""
+    check_error "drawingarea1:polyline_file 1 0 10" \
+                "ignoring GtkDrawingArea command \"drawingarea1:polyline_file 1 0 10\""
+    check_error "drawingarea1:polyline_file 1 0 nnn $FILE1" \
+                "ignoring GtkDrawingArea command \"drawingarea1:polyline_file 1 0 nnn $FILE1\""
+    check_error "drawingarea1:polyline_file 1 0 10 $BIG_STRING" \
+                "ignoring GtkDrawingArea command \"drawingarea1:polyline_file 1 0 10 $BIG_STRING\""
+    check_error "drawingarea1:rel_polyline 1 20 20 20 20 20" \
+                "ignoring GtkDrawingArea command \"drawingarea1:rel_polyline 1 20 20 20 20 20\""
+    # Valid ones draw without complaint
+    check_error "drawingarea1:polygon 1 20 20 60 20 40 50\n drawingarea1:polyline 1 70 20 90 50 110 20\n drawingarea1:stroke 1\n drawingarea1:remove 1\n nnn" \
+                "ignoring command \"nnn\""
+    head -c 4096 /dev/zero >$VERTEX_FILE
+    check_error "drawingarea1:polyline_file 1 0 256 $VERTEX_FILE\n drawingarea1:stroke 1\n nnn" \
+                "ignoring command \"nnn\""
+    # Vertex files may be rewritten in place while being drawn from
+    head -c 4096 /dev/zero | tr '\0' '\100' |
+        dd of=$VERTEX_FILE conv=notrunc 2>/dev/null
+    check_error "drawingarea1:rectangle 1 0 0 300 200\n drawingarea1:stroke 1\n nnn" \
+                "ignoring command \"nnn\""
+    # ...or shrink
+    : >$VERTEX_FILE
+    check_error "drawingarea1:rectangle 1 0 0 300 200\n drawingarea1:stroke 1\n nnn" \
+                "ignoring command \"nnn\""
+    check_error "drawingarea1:remove 1\n nnn" \
+                "ignoring command \"nnn\""
+    rm -f $VERTEX_FILE
     check_error "drawingarea1:rel_line_to" \
                 "ignoring GtkDrawingArea command \"drawingarea1:rel_line_to\""
     check_error "drawingarea1:rel_line_to " \
@@ -1391,6 +1471,34 @@ if test $AUTOMATIC; then
                 "ignoring GtkDrawingArea command \"drawingarea1:remove $BIG_STRING\""
     check_error "drawingarea1:remove 1 1" \
                 "ignoring GtkDrawingArea command \"drawingarea1:remove 1 1\""
+    check_error "drawingarea1:layer a b" \
+                "ignoring GtkDrawingArea command \"drawingarea1:layer a b\""
+    check_error "drawingarea1:series 1 1 0 0 100 100 0 1" \
+                "ignoring GtkDrawingArea command \"drawingarea1:series 1 1 0 0 100 100 0 1\""
+    check_error "drawingarea1:series 1 10 0 0 100 100 0" \
+                "ignoring GtkDrawingArea command \"drawingarea1:series 1 10 0 0 100 100 0\""
+    check_error "drawingarea1:series 1 10 0 0 100 100 1 1" \
+                "ignoring GtkDrawingArea command \"drawingarea1:series 1 10 0 0 100 100 1 1\""
+    check_error "drawingarea1:series 1 1048577 0 0 100 100 0 1" \
+                "ignoring GtkDrawingArea command \"drawingarea1:series 1 1048577 0 0 100 100 0 1\""
+    check_error "drawingarea1:set_source_rgba 1 red\n drawingarea1:series 1 5 0 0 100 100 0 1\n drawingarea1:series_add 1 1 0 1\n drawingarea1:stroke 1\n drawingarea1:remove 1\n nnn" \
+                "ignoring command \"nnn\""
+    check_error "drawingarea1:series_add 12345 1" \
+                "ignoring GtkDrawingArea command \"drawingarea1:series_add 12345 1\""
+    check_error "drawingarea1:series_add nnn" \
+                "ignoring GtkDrawingArea command \"drawingarea1:series_add nnn\""
+    check_error "drawingarea1:canvas" \
+                "ignoring GtkDrawingArea command \"drawingarea1:canvas\""
+    check_error "drawingarea1:canvas 2" \
+                "ignoring GtkDrawingArea command \"drawingarea1:canvas 2\""
+    check_error "drawingarea1:decimate" \
+                "ignoring GtkDrawingArea command \"drawingarea1:decimate\""
+    check_error "drawingarea1:decimate 1 1" \
+                "ignoring GtkDrawingArea command \"drawingarea1:decimate 1 1\""
+    check_error "drawingarea1:tiles -1" \
+                "ignoring GtkDrawingArea command \"drawingarea1:tiles -1\""
+    check_error "drawingarea1:tiles 1" \
+                "ignoring GtkDrawingArea command \"drawingarea1:tiles 1\""
     check_error "drawingarea1:set_show_text" \
                 "ignoring GtkDrawingArea command \"drawingarea1:set_show_text\""
     check_error "drawingarea1:set_show_text " \
@@ -1623,6 +1731,13 @@ if test $AUTOMATIC; then
     check 1 "" \
           "scale1:set_value .5" \
           "scale1:value 0.50"
+    check 1 "" \
+          "_:stats" \
+          "_:stats depth="
+    check 2 "" \
+          "_:begin\n scale1:set_value .25\n _:commit" \
+          "scale1:value 0.25" \
+          "_:committed "
     sleep .5
     check 0 "" \
           "_:main_quit"
@@ -1747,6 +1862,149 @@ if test $AUTOMATIC; then
     check_rm $FOUT
     rm -f $ERR_FILE $LOG
 
+    # Length-prefixed frames
+    ./pipeglade -i $FIN -o $FOUT -B -b >/dev/null
+    printf '\000\000\000\007_:stats' >$FIN
+    head -c 17 $FOUT | tail -c +5 >$OUT_FILE
+    check_cmd "grep -q '^_:stats depth' $OUT_FILE"
+    printf '\000\000\000\013_:main_quit' >$FIN
+    check_rm $FIN
+    check_rm $FOUT
+    rm -f $OUT_FILE
+
+    # Oversized frames are skipped
+    ./pipeglade -i $FIN -o $FOUT -O $ERR_FILE -B -b >/dev/null
+    (printf '\004\000\000\001'; head -c 67108865 /dev/zero;
+     printf '\000\000\000\007_:stats') >$FIN
+    head -c 17 $FOUT | tail -c +5 >$OUT_FILE
+    check_cmd "grep -q '^_:stats depth' $OUT_FILE"
+    check_cmd "grep -q 'ignoring frame of 67108865 bytes' $ERR_FILE"
+    printf '\000\000\000\013_:main_quit' >$FIN
+    check_rm $FIN
+    check_rm $FOUT
+    rm -f $OUT_FILE $ERR_FILE
+
+    # Binary arguments after the '\0' of a frame
+    ONE='\000\000\000\000\000\000\360\077'
+    TWO='\000\000\000\000\000\000\000\100'
+    ./pipeglade -i $FIN -o $FOUT -O $ERR_FILE -B -b >/dev/null
+    cat $FOUT >$OUT_FILE &
+    printf "\000\000\000\047drawingarea1:move_to 1\000$ONE$TWO\
+\000\000\000\070drawingarea1:polyline 2\000$ONE$ONE$TWO$TWO\
+\000\000\000\050drawingarea1:set_dash 3\000$ONE$TWO\
+\000\000\000\047drawingarea1:series 4 5 0 0 100 100 0 1\
+\000\000\000\052drawingarea1:series_add 4\000$ONE$TWO\
+\000\000\000\032treeview1:set 2 8\000$TWO\
+\000\000\000\026treeview1:set_cursor 2\
+\000\000\000\043drawingarea1:move_to 5\000$ONE\000\000\000\000\
+\000\000\000\060drawingarea1:polyline 6\000$ONE$ONE$TWO\
+\000\000\000\044drawingarea1:set_dash 7\000$ONE\000\000\000\000\
+\000\000\000\046drawingarea1:series_add 4\000$ONE\000\000\000\000\
+\000\000\000\026treeview1:set 2 8\000\000\000\000\000\
+\000\000\000\013_:main_quit" >$FIN
+    wait $!
+    check_cmd "grep -aq 'treeview1:gdouble 2 8 2.000000' $OUT_FILE"
+    check_cmd "! grep -q 'move_to 1\"' $ERR_FILE"
+    check_cmd "! grep -q 'polyline 2\"' $ERR_FILE"
+    check_cmd "! grep -q 'set_dash 3\"' $ERR_FILE"
+    check_cmd "! grep -q 'series 4 5 0 0 100 100 0 1\"' $ERR_FILE"
+    check_cmd "grep -q 'ignoring GtkDrawingArea command \"drawingarea1:move_to 5\"' $ERR_FILE"
+    check_cmd "grep -q 'ignoring GtkDrawingArea command \"drawingarea1:polyline 6\"' $ERR_FILE"
+    check_cmd "grep -q 'ignoring GtkDrawingArea command \"drawingarea1:set_dash 7\"' $ERR_FILE"
+    check_cmd "test \$(grep -c 'command \"drawingarea1:series_add 4\"' $ERR_FILE) -eq 1"
+    check_cmd "test \$(grep -c 'command \"treeview1:set 2 8\"' $ERR_FILE) -eq 1"
+    check_rm $FIN
+    check_rm $FOUT
+    rm -f $OUT_FILE $ERR_FILE
+
+    # Coalescing setters
+    ./pipeglade -i $FIN -o $FOUT -O $ERR_FILE -C -b >/dev/null
+    echo -e "scale1:set_range 0 10\n scale1:set_value 5\n scale1:set_range 0 100\n scale1:set_value 50\n scale1:set_value 60\n scale1:set_value nnn\n _:stats" >$FIN
+    VALUES=""
+    while read r <$FOUT; do
+        case $r in
+            scale1:value*) VALUES="$VALUES ${r#scale1:value }" ;;
+            _:stats*) break ;;
+        esac
+    done
+    check_cmd "grep -q ' 5.00' <<< '$VALUES'"
+    check_cmd "grep -q ' 60.00$' <<< '$VALUES'"
+    check_cmd "grep -q ' coalesced=[0-2]$' <<< '$r'"
+    check_cmd "test \$(grep -c 'command \"scale1:set_value nnn\"' $ERR_FILE) -eq 1"
+    echo -e "_:main_quit" > $FIN
+    check_rm $FIN
+    check_rm $FOUT
+    rm -f $ERR_FILE
+
+    # Executing commands in step with frames
+    ./pipeglade -i $FIN -o $FOUT -O $ERR_FILE -F -b >/dev/null
+    echo -e "drawingarea1:rectangle 1 10 10 50 50\n drawingarea1:set_source_rgba 1 green\n drawingarea1:fill 1\n _:begin\n drawingarea1:translate 2 20 20\n drawingarea1:rectangle 3 10 10 50 50\n drawingarea1:stroke 3\n _:commit\n scale1:set_value 7\n drawingarea1:snapshot $SVG_FILE\n _:stats" >$FIN
+    read r <$FOUT
+    check_cmd "grep -q '^_:committed ' <<< '$r'"
+    read r <$FOUT
+    check_cmd "test '$r' = 'scale1:value 7.00'"
+    read r <$FOUT
+    check_cmd "grep -q '^_:stats depth=0 ' <<< '$r'"
+    check_cmd "test -s $SVG_FILE"
+    check_cmd "(! grep -q 'ignoring' $ERR_FILE)"
+    echo -e "_:main_quit" > $FIN
+    check_rm $FIN
+    check_rm $FOUT
+    rm -f $ERR_FILE $SVG_FILE
+
+    # Instances from a zygote
+    ./pipeglade -Z $ZYGOTE_SOCKET pipeglade.ui &
+    ZYGOTE_PID=$!
+    for i in {1..50}; do test -S $ZYGOTE_SOCKET && break; sleep .1; done
+    check_cmd "test -S $ZYGOTE_SOCKET"
+    check_call "./pipeglade -z $ZYGOTE_SOCKET -u nonexistent.ui" 1 \
+               "nonexistent.ui" ""
+    ./pipeglade -z $ZYGOTE_SOCKET -i $FIN -o $FOUT -b >/dev/null
+    echo -e "_:stats" > $FIN
+    read r <$FOUT
+    check_cmd "grep -q '^_:stats depth' <<< '$r'"
+    echo -e "_:main_quit" > $FIN
+    check_rm $FIN
+    check_rm $FOUT
+    kill $ZYGOTE_PID
+    wait $ZYGOTE_PID
+    check_rm $ZYGOTE_SOCKET
+
+    # Socket clients
+    if command -v socat >/dev/null; then
+        ./pipeglade -s $SOCKET -O $ERR_FILE -b >/dev/null
+        for i in {1..50}; do test -S $SOCKET && break; sleep .1; done
+        coproc CLIENT { socat - UNIX-CONNECT:$SOCKET; }
+        echo -e "button1:subscribe\n scale1:set_value 3\n _:stats" >&${CLIENT[1]}
+        read -t 2 r <&${CLIENT[0]}
+        check_cmd "grep -q '^_:stats depth=' <<< '$r'"
+        r=$( (echo "_:stats"; sleep 1) | socat - UNIX-CONNECT:$SOCKET)
+        check_cmd "grep -q '^_:stats depth=' <<< '$r'"
+        echo "button1:ping 1" >&${CLIENT[1]}
+        read -t 2 r <&${CLIENT[0]}
+        check_cmd "test '$r' = 'button1:ping 1'"
+        eval "exec ${CLIENT[1]}>&-"
+        wait $CLIENT_PID
+        r=$( (echo "scale1:ping 2"; sleep 1) | socat - UNIX-CONNECT:$SOCKET)
+        check_cmd "test '$r' = 'scale1:ping 2'"
+        (echo "_:main_quit"; sleep .5) | socat - UNIX-CONNECT:$SOCKET >/dev/null
+        check_rm $SOCKET
+        check_cmd "(! grep -q 'ignoring' $ERR_FILE)"
+        rm -f $ERR_FILE
+    fi
+
+    # Startup timing
+    ./pipeglade -i $FIN -o $FOUT -l $LOG -T -b >/dev/null
+    echo -e "_:stats" > $FIN
+    read r <$FOUT
+    check_cmd "grep -q '^startup	gtk_init	[0-9]*	[0-9]*$' $LOG"
+    check_cmd "grep -q '^startup	prepare_widgets	[0-9]*	[0-9]*$' $LOG"
+    check_cmd "grep -q '^widget	GtkWindow	2	[0-9]*$' $LOG"
+    echo -e "_:main_quit" > $FIN
+    check_rm $FIN
+    check_rm $FOUT
+    rm -f $LOG
+
     ./pipeglade -u clock.ui -i $FIN -o $FOUT -b
     check 0 "" \
           "main:resize 500 600\n main:move 100 100"
@@ -2594,6 +2852,17 @@ if test $INTERACTIVE; then
     check 1 "Press \"OK\" if font and colors changed in previous steps are back to normal\n switch1:style" \
           "checkbutton1:style" \
           "button1:clicked"
+    echo ".alarm { background-color: yellow; }" >$CSS_FILE
+    check 1 "Press \"OK\" if the background of \"checkbutton1\" has turned yellow" \
+          "_:stylesheet $CSS_FILE\n checkbutton1:add_class alarm" \
+          "button1:clicked"
+    check 1 "Press \"OK\" if the background of \"checkbutton1\" is still yellow" \
+          "_:stylesheet nonexistent.css" \
+          "button1:clicked"
+    check 1 "Press \"OK\" if the background of \"checkbutton1\" is back to normal" \
+          "checkbutton1:remove_class alarm" \
+          "button1:clicked"
+    rm -f $CSS_FILE
     check 1 "" \
           "switch1:force" \
           "switch1:1"
@@ -2729,6 +2998,14 @@ if test $INTERACTIVE; then
     check 1 "Press \"OK\" if all three brown shapes look the same" \
           "drawingarea1:remove 3" \
           "button1:clicked"
+    check 1 "Press \"OK\" if everything is no longer rotated but moved to the right" \
+          "drawingarea1:translate =105 30 0" \
+          "button1:clicked"
+    check 1 "Press \"OK\" if everything moved back to the left" \
+          "drawingarea1:line_to =105 0 0" \
+          "button1:clicked"
+    check 0 "" \
+          "drawingarea1:remove 105"
 
 fi
 
@@ -2738,6 +3015,28 @@ check 0 "" \
       "drawingarea1:move_to 5 10 50\n drawingarea1:set_source_rgba 5 cyan\n drawingarea1:set_font_size 5 30\n drawingarea1:show_text 5 Xyz 789\n drawingarea1:set_font_size 5 10\n drawingarea1:show_text 5 Abc 123"
 check 0 "" \
       "drawingarea1:move_to 5 10 75\n drawingarea1:set_source_rgba 5 red\n drawingarea1:set_font_face 5 italic bold Courier\n drawingarea1:set_font_size 5 30\n drawingarea1:show_text 5 Xyz 789\n drawingarea1:set_font_size 5 10\n drawingarea1:show_text 5 Abc 123"
+check 0 "" \
+      "drawingarea1:layer grid\n drawingarea1:rectangle 7 0 0 300 200\n drawingarea1:set_source_rgba 7 rgba(0,0,255,.1)\n drawingarea1:fill 7\n drawingarea1:layer"
+check 0 "" \
+      "drawingarea1:layer grid\n drawingarea1:remove 7\n drawingarea1:layer"
+check 0 "" \
+      "drawingarea1:canvas 1\n drawingarea1:set_source_rgba 8 orange\n drawingarea1:move_to 8 10 190\n drawingarea1:line_to 8 290 110\n drawingarea1:stroke 8"
+check 0 "" \
+      "drawingarea1:canvas 0"
+check 0 "" \
+      "drawingarea1:set_source_rgba 9 purple\n drawingarea1:polygon 9 20 20 60 20 40 50\n drawingarea1:fill 9\n drawingarea1:polyline 9 70 20 90 50 110 20\n drawingarea1:rel_polyline 9 20 30 20 -30\n drawingarea1:stroke 9"
+check 0 "" \
+      "drawingarea1:decimate 1"
+check 0 "" \
+      "drawingarea1:set_source_rgba 10 blue\n drawingarea1:series 10 5 150 20 100 50 0 10\n drawingarea1:series_add 10 1 9 3 7 5 5\n drawingarea1:stroke 10"
+check 0 "" \
+      "drawingarea1:decimate 0"
+check 0 "" \
+      "drawingarea1:tiles 64\n drawingarea1:set_source_rgba 9 green\n drawingarea1:rectangle 9 100 60 150 100\n drawingarea1:stroke 9"
+check 0 "" \
+      "drawingarea1:tiles 0"
+check 0 "" \
+      "drawingarea1:remove 9\n drawingarea1:remove 10"
 check 0 "" \
       "drawingarea1:remove 1\n drawingarea1:remove 2\n drawingarea1:remove 3\n drawingarea1:remove 4"
 check 2 "" \